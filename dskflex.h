@@ -16,12 +16,13 @@
    along with this program; if not, write to the Free Software
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
 
-#define _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <time.h>
+#include <limits.h>
 #include <utime.h>
 #include <unistd.h>
 #include <stdint.h>
@@ -32,6 +33,9 @@
 #include <signal.h>
 #include <ctype.h>
 #include <getopt.h>
+#include <fnmatch.h>
+#include <errno.h>
+#include "flstats.h"
 
 // Sector size for Flex floppy
 
@@ -52,6 +56,8 @@ extern struct Disk {
     int freesec;         // Number of free sectors
     uint8_t readonly;    // Image file is readonly ? 
     int track0l;         // number of sectors on track 0
+    uint8_t *loaded;     // sectors read if partially loaded, else NULL
+    char *base;          // base image if the file is an overlay, else NULL
 } disk;
 
 // System Information record -- Not used yet
@@ -139,7 +145,95 @@ extern uint8_t blk2sec( int index);
 extern uint8_t *ts2pos( uint8_t ntrk, uint8_t nsec);
 extern int getname( uint8_t *pos, char *name, int dot);
 extern int analyse( int strict);
+extern int analyse_dir( int strict); // lazy: directory only
+extern int check_file( int k);       // lazy: verify chain of file k
 extern int list_files( int details);
+extern int find_file( char *name);   // index in file[] or -1
+
+// image loading (flimage.c)
+extern int load_image( char *filepath, int partial);
+extern int load_all( void);
+extern int read_sectors( int first, int n);
+extern uint8_t *getsec( int ibloc);
+extern int save_image( char *filepath);
+extern int write_sectors( char *filepath, int first, int n);
+extern void close_image( void);
+
+// freelist (flalloc.c)
+extern int get_link( int ibloc);
+extern void set_link( int ibloc, int next);
+extern int alloc_sectors( int n, int contiguous);
+extern void free_sectors( int first, int last, int n);
+extern int grow_dir( void);           // 10 more entries, index of first
+
+// random files records (flrand.c)
+#define RECSIZE 252  // data bytes of a record, one sector
+#define MAXREC (168 * 255)  // records a map can hold: 168 runs of 255 sectors
+extern int rec2blk( int k, int rec);
+extern int get_record( int k, int rec, uint8_t *buf);
+extern int put_record( char *filepath, int k, int rec, uint8_t *buf);
+extern int build_map( int k);
+extern int check_map( int k);   // 0 ok, 1 not minimal, 2 wrong
+
+// files written out (flextract.c)
+extern int write_file( int k, char *path, int convert, int replace);
+extern int tar_file( int fd, int k, char *name);
+extern int tar_end( int fd);
+
+// geometry conversion (flremap.c)
+struct Geometry {
+    int nbtrk;      // number of tracks, track 0 included
+    int nbsec;      // sectors per track
+    int track0;     // sectors on track 0
+};
+extern int remap_image( struct Geometry *g, uint8_t **out, int *nb_sectors);
+
+// checksums (flcrc.c)
+extern uint32_t crc32c( uint32_t crc, uint8_t *buf, size_t len);
+extern uint32_t sector_crcs( uint32_t *crc);  // one per sector, return image CRC
+extern uint32_t file_crc( int k);
+extern uint64_t logical_hash( void);          // same files => same hash
+
+// sector patches (fldelta.c)
+extern int diff_sectors( uint8_t *base, uint8_t *changed);
+extern int write_patch( int fd, uint8_t *base, uint8_t *changed, uint32_t oldcrc, uint32_t newcrc);
+extern int read_patch( char *path, uint8_t **buf, long *size);
+extern int apply_patch( uint8_t *patch, char *filepath);  // -1 if already applied
+
+// copy-on-write overlays (floverlay.c)
+extern int open_overlay( char *filepath, struct stat *dsk_stat);  // by load_image()
+extern void read_overlay( int first, int n);
+extern int write_overlay( char *filepath, int first, int n);
+extern int save_overlay( char *filepath);
+extern void close_overlay( void);
+extern int create_overlay( char *base, char *filepath);
+extern int reset_overlay( char *filepath, int commit);   // commit or discard
+extern int overlay_sectors( uint8_t *in);
+
+// analyse cache (flcache.c)
+extern uint64_t hash64( uint8_t *buf, size_t len);
+extern uint64_t mix64( uint64_t h);
+extern int analyse_cached( char *filepath, int strict);
+extern void drop_cache( char *filepath);
+
+// synthetic images for benchmarks (flgen.c)
+struct Genspec {
+    char *name;     // workload name, also used as volume label
+    int nbtrk;      // number of tracks, track 0 included
+    int nbsec;      // sectors per track
+    int track0;     // sectors on track 0 (0: same as other tracks)
+    int nfiles;     // number of files (updated with what was built)
+    int nrandom;    // of which random files
+    int ndeleted;   // deleted entries, their chains are in the freelist
+    int fill;       // percentage of the data sectors used by files
+    int frag;       // percentage of data sectors out of sequence
+    int used;       // set by gen_image(): sectors used by valid files
+};
+extern uint8_t *gen_image( struct Genspec *spec, uint64_t seed, int *nb_sectors);
+extern int write_image( char *filepath, uint8_t *dsk, int nb_sectors);
+enum Hostile { H_CROSSLINK, H_SELFLOOP, H_FREECYCLE, H_DIRCHAIN, H_BADLEN, NB_HOSTILE };
+extern char *hostile_name[NB_HOSTILE];
+extern uint8_t *gen_hostile( int kind, struct Genspec *spec, uint64_t seed, int *nb_sectors);
 
 // static char *month[] = {"Jan","Feb","Mar","Apr","May","Jun","Jul","Aug","Sep","Oct","Nov","Dec"};
 
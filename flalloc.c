@@ -0,0 +1,155 @@
+/* flalloc.c -- Allocation of sectors from the Flex freelist
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+// The free sectors are chained from the SIR (0x21d-0x220), with
+// their count at 0x221. The links are read in the sectors themselves,
+// nxtsec is kept up to date if it was built by analyse().
+
+// Link of a bloc, 0 at end of chain, -1 if out of bounds
+
+int get_link( int ibloc) {
+  uint8_t *psec = getsec( ibloc);
+
+  flstat.hops++;
+  return psec[0] == 0 && psec[1] == 0 ? 0 : ts2blk( psec[0], psec[1]);
+}
+
+// Set the link of a bloc (0 = end of chain)
+
+void set_link( int ibloc, int next) {
+  uint8_t *psec = getsec( ibloc);
+
+  psec[0] = next ? blk2trk( next) : 0;
+  psec[1] = next ? blk2sec( next) : 0;
+  if (nxtsec != NULL)
+    nxtsec[ibloc] = next;
+}
+
+// Update the free sectors count in the SIR
+
+static void set_freesec( int n) {
+  disk.freesec = n;
+  disk.dsk[0x221] = (uint8_t) (n / 256);
+  disk.dsk[0x222] = (uint8_t) (n % 256);
+}
+
+///////////////////////////////////////////////////////////
+// Take n sectors from the freelist, chained together,   //
+// the link of the last one set to 0. If contiguous,     //
+// they are the first run of n consecutive blocs found   //
+// in the freelist, else the n first ones.               //
+// Return the first bloc, -1 if there is not enough free //
+// space, -2 if no run is long enough                    //
+///////////////////////////////////////////////////////////
+
+int alloc_sectors( int n, int contiguous) {
+  int prev = 0;           // bloc before the run, 0 if run at head
+  int first, last, ibloc, len, seen;
+
+  if (n < 1 || n > disk.freesec)
+    return -1;
+  first = ts2blk( disk.dsk[0x21d], disk.dsk[0x21e]);
+  if (first < 1)
+    return -1;
+
+// Walk the freelist until the run is long enough
+  last = first;
+  len = 1;
+  for (seen = 1; len < n; seen++) {
+    if ((ibloc = get_link( last)) <= 0 || seen >= disk.freesec)
+      return contiguous ? -2 : -1;
+    if (contiguous && ibloc != last + 1) {
+      prev = last;        // new run
+      first = ibloc;
+      len = 1;
+    } else
+      len++;
+    last = ibloc;
+  }
+
+// Unlink the run from the freelist
+  ibloc = get_link( last);
+  if (prev == 0) {
+    disk.dsk[0x21d] = ibloc > 0 ? blk2trk( ibloc) : 0;
+    disk.dsk[0x21e] = ibloc > 0 ? blk2sec( ibloc) : 0;
+  } else
+    set_link( prev, ibloc > 0 ? ibloc : 0);
+  if (ibloc <= 0) {       // the run was at the end
+    disk.dsk[0x21f] = prev ? blk2trk( prev) : 0;
+    disk.dsk[0x220] = prev ? blk2sec( prev) : 0;
+  }
+  set_link( last, 0);
+  set_freesec( disk.freesec - n);
+  return first;
+}
+
+/////////////////////////////////////////////////////////
+// Give a chain of n sectors, from first to last, back //
+// to the freelist: it is linked after its end         //
+/////////////////////////////////////////////////////////
+
+void free_sectors( int first, int last, int n) {
+  if (disk.freesec == 0) {
+    disk.dsk[0x21d] = blk2trk( first);
+    disk.dsk[0x21e] = blk2sec( first);
+  } else
+    set_link( ts2blk( disk.dsk[0x21f], disk.dsk[0x220]), first);
+  set_link( last, 0);
+  disk.dsk[0x21f] = blk2trk( last);
+  disk.dsk[0x220] = blk2sec( last);
+  set_freesec( disk.freesec + n);
+}
+
+/////////////////////////////////////////////////////////
+// Add a sector taken from the freelist at the end of  //
+// the directory chain: 10 more free entries in file[] //
+// Return the index of the first one, -1 if no sector  //
+// is free                                             //
+/////////////////////////////////////////////////////////
+
+int grow_dir( void) {
+  struct File *table;
+  struct Dirsec *ds;
+  int ibloc, last, n, k;
+
+// Last directory sector (analyse() returned 3 if the chain loops)
+  last = ts2blk( 0, 5);
+  for (n = 0; n < disk.nb_sectors && (ibloc = get_link( last)) > 0; n++)
+    last = ibloc;
+
+  if ((ibloc = alloc_sectors( 1, 0)) < 0)
+    return -1;
+  if ((table = realloc( file, sizeof( struct File) * (nslot + 10))) == NULL) {
+    free_sectors( ibloc, ibloc, 1);
+    return -1;
+  }
+  file = table;
+
+  ds = (struct Dirsec *)getsec( ibloc);
+  memset( ds, 0, SECSIZE);
+  set_link( last, ibloc);
+  if (tabsec != NULL)
+    tabsec[ibloc] = 0;    // directory bloc
+  for (k = 0; k < 10; k++) {
+    memset( &file[nslot + k], 0, sizeof( struct File));
+    file[nslot + k].pos = ds->entry[k].name;
+  }
+  nslot += 10;
+  return nslot - 10;
+}
@@ -33,8 +33,9 @@ void usage( char *cmd) {
   fprintf( stderr, "       %s [-q|-v] [-r] <file>\n", cmd);
   fprintf( stderr, "Options:\n");
   fprintf( stderr, "   -q => quiet, don't print anything\n");
-  fprintf( stderr, "   -r => repair and/or reorder free sector list\n");
+  fprintf( stderr, "   -r => repair and/or reorder free sector list, rebuild random files maps\n");
   fprintf( stderr, "   -v => print more details\n");
+  fprintf( stderr, "   --stats[=json] => print timings and counters on stderr\n");
 }
 
 // Analyse the content of the disk loaded
@@ -51,6 +52,11 @@ int browse_dsk( int retval) {
   if (!quiet)
 	list_files( verbose);
 
+// Files in bad sequence, only reported by analyse(): -r renumbers them
+  for (k = 0; k < nslot; k++)
+    if ((file[k].flags & 0x08) && retval < 1)
+      retval = 1;
+
 // Reserved sectors verification
 
   for (k=0; k < 4; k++) {
@@ -70,9 +76,25 @@ int browse_dsk( int retval) {
         retval = 1;
       if (!quiet)
         printf( "%sWarning: reserved sector [00/%02X] in file %s (%d)%s\n",
-          s_warn, k+1, file[tabsec[k]].name, tabsec[k], s_norm);
+          s_warn, k+1, file[tabsec[k]-1].name, tabsec[k], s_norm);
     }
   }
+
+// Random files: map verified against the chain of sectors
+
+  for (k = 0; k < nslot; k++) {
+    if ((file[k].flags & 0xD3) != 0x03)  // valid random files only
+      continue;
+    j = check_map( k);
+    if (j == 2) {
+      if (retval < 1)
+        retval = 1;
+      if (!quiet)
+        printf( "%sWarning: map of random file %s doesn't match its sectors%s\n",
+          s_warn, file[k].name, s_norm);
+    } else if (j == 1 && verbose)
+      printf( "Map of random file %s could be shorter\n", file[k].name);
+  }
   return retval;
 }
 
@@ -85,6 +107,9 @@ int repar_dsk( int repar) {
   uint8_t *orig, *dest;
 
   int free_nb, reorg, free_start; // For free list reorganisation
+  int nmap = 0;                   // random files maps rebuilt
+  int nseq = 0;                   // files renumbered
+  int n, seq;
 
 // Verify real size of disk... correct if false
   if (disk.nbtrk < disk.dsk[0x226]) {
@@ -156,6 +181,28 @@ int repar_dsk( int repar) {
     reorg++;
   }
 
+// Renumber the records of the files in bad sequence (as the old
+// flwrite wrote files of 256 sectors or more), in the order of
+// their chain: the map sectors of a random file are 0
+
+  for (k = 0; k < nslot; k++) {
+    if ((file[k].flags & 0xD9) != 0x09)
+      continue;
+    ibloc = ts2blk( file[k].start_trk, file[k].start_sec);
+    for (n = 0; n < file[k].length && ibloc > 0; n++) {
+      if (file[k].flags & 2)
+        seq = n < 2 ? 0 : n - 1;
+      else
+        seq = n + 1;
+      current_sector = getsec( ibloc);
+      current_sector[2] = (uint8_t) (seq / 256);
+      current_sector[3] = (uint8_t) (seq & 0xFF);
+      ibloc = nxtsec[ibloc];
+    }
+    file[k].flags &= ~0x08;
+    nseq++;
+  }
+
 //////////////////////////////////////////////////////
 // Recovery of deleted entries space in directory   //
 // If the linked list of free sectors was modified, //
@@ -167,7 +214,7 @@ int repar_dsk( int repar) {
 	nfile = nslot-1;
 	while (nfile >=0 && file[nfile].flags == 0)
 	  nfile--;                       // go before last free slot
-	while ((file[j].flags & 0x10) != 0x10)
+	while (j < nslot && (file[j].flags & 0x10) != 0x10)
 	  j++;                           // go to next deleted file
 	while (j < nfile) {
 	  if ((file[nfile].flags & 0x10) != 0x10) {
@@ -175,8 +222,8 @@ int repar_dsk( int repar) {
 		dest = file[j].pos;
 		for (i = 0; i < 24; i++)     // move last entry 
 		  dest[i] = orig[i];
-		j++;
 		file[j].flags = 1;
+		j++;
 	  }
 	  orig = file[nfile].pos;
       for (i = 0; i < 24; i++)       // clean last deleted entry
@@ -194,6 +241,18 @@ int repar_dsk( int repar) {
 	}
   }
 
+// Rebuild maps of random files that are wrong or not minimal
+
+  for (k = 0; k < nslot; k++) {
+    if ((file[k].flags & 0xD3) != 0x03 || check_map( k) < 1)
+      continue;
+    if (build_map( k))
+      printf( "%sERROR: random file %s too fragmented, its map stays incomplete%s\n",
+        s_err, file[k].name, s_norm);
+    else
+      nmap++;
+  }
+
 // Final stats printed
 
   if (!quiet) {
@@ -204,6 +263,10 @@ int repar_dsk( int repar) {
       printf( "New free list of %d sectors created (%d modifications)\n", free_nb, reorg);
 	else
       printf( "Freelist clean: no modification needed\n");
+    if (nmap)
+      printf( "Map of %d random file(s) rebuilt\n", nmap);
+    if (nseq)
+      printf( "Records of %d file(s) renumbered\n", nseq);
   }
 
   return 0;
@@ -213,9 +276,9 @@ int repar_dsk( int repar) {
 
 int main( int argc, char **argv)
 {
+  static struct option longopts[] = { STATS_OPTION, { 0, 0, 0, 0 } };
   int opt;
   char *filepath;
-  char *backup;
   struct stat dsk_stat;
   char *term, *getenv( const char *name);
   int repar = 0; // image must be repared and/or freelist reorganised
@@ -224,7 +287,7 @@ int main( int argc, char **argv)
                  // 0: everything is ok ; 1: freelist uncomplete or damaged
                  // 2: disk structure not reparable ; 3: unable to process 
 // Read parameters
-  while ((opt = getopt( argc, argv, "hvqr")) != -1) {
+  while ((opt = getopt_long( argc, argv, "hvqr", longopts, NULL)) != -1) {
     switch (opt) {
     case 'h':
       usage( *argv);
@@ -239,6 +302,9 @@ int main( int argc, char **argv)
     case 'r':
       repar++;
       break;
+    case 'S':
+      stats_init( *argv, optarg);
+      break;
     default: /* '?' */
       usage( *argv);
       exit( 3);
@@ -282,13 +348,6 @@ int main( int argc, char **argv)
     }
   }
 
-// Open disk image and map it in memory
-  disk.shortname = strrchr( filepath, '/');
-  if (disk.shortname == NULL)
-    disk.shortname = filepath;
-  else
-    disk.shortname++;
-
   if ((dsk_stat.st_mode & S_IWUSR) && repar) {
     disk.readonly = 0;
   } else {
@@ -300,24 +359,9 @@ int main( int argc, char **argv)
     }
   }
 
-  if ((disk.fd = open( filepath, O_RDONLY)) < 0 ) {
-    perror( filepath);
-    exit( 3);
-  }
-
-  disk.size = dsk_stat.st_size;
-  disk.dsk = malloc( dsk_stat.st_size);
-
-  if (disk.dsk == NULL) {
-    perror( "malloc: ");
-    exit( 3);
-  }
-
-  if (read( disk.fd, disk.dsk, dsk_stat.st_size) != dsk_stat.st_size) {
-    perror( filepath) ;
+// Open disk image and load it in memory
+  if (load_image( filepath, 0))
     exit( 3);
-  }
-  close( disk.fd);
 
   if (! isFlex( disk.dsk, disk.nb_sectors))
     exit( 2);
@@ -325,7 +369,7 @@ int main( int argc, char **argv)
   if ((badFlex( 0) & 0xFF) > 1)
     exit( 2);
 
-  retval = analyse(!quiet);
+  retval = analyse_cached( filepath, !quiet);
   if (!repar && retval > 1)
     return retval;
 
@@ -334,29 +378,15 @@ int main( int argc, char **argv)
   if (!repar)
     return retval;
 
-  if (retval = repar_dsk( repar)) {
+  stat_start( PH_REPAIR);
+  retval = repar_dsk( repar);
+  stat_stop( PH_REPAIR);
+  if (retval) {
     printf( "%sUnable to restore consistency, aborting.%s\n", s_err, s_norm);
     return retval;
   }
 
-  backup = malloc( strlen( filepath) + 4);
-  strcpy( backup, filepath);
-  strcat( backup, ".bak");
-  if (rename( filepath, backup)) {
-    perror( backup);
-    return 3;
-  }
-  disk.fd = creat( filepath, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
-
-  if (disk.fd == -1) {
-    perror( "create: ");
+  if (save_image( filepath))
     exit( 3);
-  }
-
-  if (write( disk.fd, disk.dsk, dsk_stat.st_size) != dsk_stat.st_size) {
-    perror( "rewrite:") ;
-    exit( 3);
-  }
-  close( disk.fd);
 
 }
@@ -0,0 +1,1003 @@
+/* flbench.c -- Benchmarks of the Flex disk image tools
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#define _DEFAULT_SOURCE   // for wait4()
+#include "dskflex.h"
+#include "flconv.h"
+#include <sys/wait.h>
+#include <dirent.h>
+#include <ftw.h>
+#include <sys/resource.h>
+
+int verbose = 0;
+int quiet = 1;
+
+char *s_err = "",
+     *s_warn = "",
+     *s_norm = "";
+
+// Workloads: from a single density floppy to the biggest hard disk image.
+// The seed is fixed so that the images are the same from run to run.
+
+#define SEED 0x464C4558   // "FLEX"
+
+struct Genspec workload[] = {
+//   name            trk  sec  t0  files rnd  del fill frag
+  { "sssd40",         40,  10,  0,    20,  2,   3,  70,   0 },
+  { "sssd40-frag",    40,  10,  0,    20,  2,   3,  70,  50 },
+  { "dsdd40",         40,  36, 20,   100, 10,  10,  80,  10 },
+  { "dsdd80-frag",    80,  36, 20,   150, 10,  20,  85,  60 },
+  { "hd-few",        256, 255,  0,    50,  5,   5,  60,   0 },
+  { "hd-many",       256, 255,  0,  2000, 100, 200, 90,  30 },
+  { "hd-frag",       256, 255,  0,   500, 50,  50,  90, 100 },
+  { NULL }
+};
+
+// Results, saved or compared to a baseline
+
+struct Result {
+    char name[32];       // workload/operation
+    double mbs;          // throughput, MB/s
+    double ops;          // operations per second
+};
+
+#define MAXRES 128
+
+static struct Result result[MAXRES];
+static int nres = 0;
+static char tooldir[PATH_MAX];   // where flan, fldump... are
+static char workdir[64];         // temporary directory
+static int keep = 0;             // keep the generated images
+
+void usage( char *cmd) {
+	fprintf( stderr, "Usage: %s [-h] => this help\n", cmd);
+	fprintf( stderr, "       %s [-q] [-k] [-s file] [-c file [-t percent]] [workload...]\n", cmd);
+	fprintf( stderr, "       %s -w [-k] => damaged images, check that the tools scale\n", cmd);
+	fprintf( stderr, "       %s -x [-s file] [-c file [-t percent]] => text and S19 converters\n", cmd);
+    fprintf( stderr, "Options:\n");
+	fprintf( stderr, "   -c => compare the results with a baseline saved with -s\n");
+	fprintf( stderr, "   -k => keep the generated images\n");
+	fprintf( stderr, "   -q => quick, only the floppy images\n");
+	fprintf( stderr, "   -s => save the results as a baseline in file\n");
+	fprintf( stderr, "   -t => slowdown accepted by -c before failing (default 20%%)\n");
+	fprintf( stderr, "   -w => worst cases: time and memory must grow like the image size\n");
+	fprintf( stderr, "   -x => converters, with round trip checks\n");
+}
+
+// Monotonic clock in seconds
+
+static double now( void) {
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Record the result of an operation
+
+static struct Result *add_result( char *wname, char *op, double sec, double bytes, double ops) {
+  static struct Result dummy;
+  struct Result *r;
+
+  r = nres < MAXRES ? &result[nres++] : &dummy;
+  snprintf( r->name, sizeof( r->name), "%s/%s", wname, op);
+  r->mbs = sec > 0 ? bytes / sec / 1e6 : 0;
+  r->ops = sec > 0 ? ops / sec : 0;
+  return r;
+}
+
+// Record and print the result of an operation
+
+static void report( char *wname, char *op, double sec, double bytes, double ops) {
+  struct Result *r;
+
+  r = add_result( wname, op, sec, bytes, ops);
+  printf( "%-24s %10.3f ms %10.2f MB/s %12.1f ops/s\n", r->name, sec * 1e3, r->mbs, r->ops);
+}
+
+////////////////////////////////////////////////////////
+// Run one of the tools in directory dir, its output  //
+// is thrown away. Return the elapsed time in seconds //
+// or -1 if the tool failed (exit status over maxst,  //
+// killed or too slow). Its resources are put in ru  //
+////////////////////////////////////////////////////////
+
+#define TIMEOUT 30        // seconds before a run is killed
+
+static double run( char *dir, char **args, int maxst, struct rusage *ru) {
+  char path[PATH_MAX + 16];
+  struct rusage usage;
+  struct rlimit fsize;
+  double start;
+  pid_t pid;
+  int status, fd;
+
+  snprintf( path, sizeof( path), "%s/%s", tooldir, args[0]);
+  start = now();
+  if ((pid = fork()) == 0) {
+    if (chdir( dir) != 0)
+      _exit( 127);
+    fd = open( "/dev/null", O_WRONLY);
+    dup2( fd, 1);
+    dup2( fd, 2);
+// Neither a loop nor a runaway output can block the bench
+    fsize.rlim_cur = fsize.rlim_max = 256L << 20;
+    setrlimit( RLIMIT_FSIZE, &fsize);
+    alarm( TIMEOUT);
+    execv( path, args);
+    _exit( 127);
+  }
+  if (pid < 0 || wait4( pid, &status, 0, &usage) < 0) {
+    perror( "fork");
+    return -1;
+  }
+  if (WIFSIGNALED( status)) {
+    fprintf( stderr, "%s: killed by signal %d\n", args[0], WTERMSIG( status));
+    return -1;
+  }
+  if (!WIFEXITED( status) || WEXITSTATUS( status) > maxst) {
+    fprintf( stderr, "%s: exit status %d\n", args[0], WEXITSTATUS( status));
+    return -1;
+  }
+  if (ru != NULL)
+    *ru = usage;
+  return now() - start;
+}
+
+// Remove a directory tree
+
+static int rm_entry( const char *path, const struct stat *sb, int flag, struct FTW *ftw) {
+  return remove( path);
+}
+
+static void rm_tree( char *path) {
+  nftw( path, rm_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+// Number of files in a directory tree
+
+static int nb_found;
+
+static int count_entry( const char *path, const struct stat *sb, int flag, struct FTW *ftw) {
+  if (flag == FTW_F)
+    nb_found++;
+  return 0;
+}
+
+static int count_files( char *path) {
+  nb_found = 0;
+  nftw( path, count_entry, 16, FTW_PHYS);
+  return nb_found;
+}
+
+/////////////////////////////////////////////////////////
+// Best time of REPS runs of a tool. Before each run,  //
+// path is overwritten with img, or removed if no img  //
+/////////////////////////////////////////////////////////
+
+#define REPS 5
+
+static double best_run( char *dir, char **args, char *path, uint8_t *img, int nb) {
+  double sec, best = -1;
+  int r;
+
+  for (r = 0; r < REPS; r++) {
+    if (img != NULL)
+      write_image( path, img, nb);
+    else
+      rm_tree( path);
+    if ((sec = run( dir, args, 1, NULL)) < 0)
+      return -1;
+    if (best < 0 || sec < best)
+      best = sec;
+  }
+  return best;
+}
+
+////////////////////////////////////////////////////////
+// analyse() in the same process: repeated until 0.2s //
+// are spent, to smooth the small images              //
+////////////////////////////////////////////////////////
+
+static void bench_analyse( struct Genspec *spec, char *image) {
+  double start, sec;
+  int reps = 0;
+
+  start = now();
+  do {
+    if (load_image( image, 0) || !isFlex( disk.dsk, disk.nb_sectors) ||
+        badFlex( 0) > 1 || analyse( 0) > 1) {
+      fprintf( stderr, "%s: analyse failed\n", spec->name);
+      close_image();
+      return;
+    }
+    close_image();
+    reps++;
+  } while ((sec = now() - start) < 0.2);
+  report( spec->name, "analyse", sec / reps, (double)disk.size, 1);
+}
+
+/////////////////////////////////////////////////////
+// The tools, run on a copy of the generated image //
+/////////////////////////////////////////////////////
+
+static void bench_tools( struct Genspec *spec, char *image, uint8_t *dsk, int nb) {
+  char dir[128], copy[128], xdir[160], label[16];
+  char **args, **names;
+  struct Genspec empty;
+  struct dirent *de;
+  double sec;
+  uint8_t *edsk;
+  int nbe, n, k, nnames;
+  DIR *dp;
+
+  snprintf( dir, sizeof( dir), "%s/%s.x", workdir, spec->name);
+  snprintf( copy, sizeof( copy), "%s/%s.copy.dsk", workdir, spec->name);
+  mkdir( dir, 0755);
+  args = malloc( sizeof( char *) * (spec->nfiles + 8));
+
+// Extraction of all files, in a directory named after the volume
+  memcpy( label, dsk + 0x210, 11);
+  for (k = 0; k < 11 && label[k]; k++)
+    ;
+  label[k] = 0;
+  snprintf( xdir, sizeof( xdir), "%s/%s_%u", dir, label, dsk[0x21b] * 256 + dsk[0x21c]);
+  args[0] = "fldump"; args[1] = "-q"; args[2] = image; args[3] = NULL;
+  if ((sec = best_run( dir, args, xdir, NULL, 0)) >= 0)
+    report( spec->name, "extract", sec, spec->used * 252.0, spec->nfiles);
+
+// Insertion of the extracted files in an empty image of same geometry
+  empty = *spec;
+  empty.nfiles = empty.nrandom = empty.ndeleted = 0;
+  edsk = gen_image( &empty, SEED, &nbe);
+
+  names = malloc( sizeof( char *) * (spec->nfiles + 1));
+  nnames = 0;
+  if ((dp = opendir( xdir)) != NULL) {
+    while ((de = readdir( dp)) != NULL && nnames < spec->nfiles)
+      if (de->d_name[0] != '.')
+        names[nnames++] = strdup( de->d_name);
+    closedir( dp);
+  }
+
+  n = 0;
+  args[n++] = "flwrite";
+  for (k = 0; k < nnames; k++)
+    args[n++] = names[k];
+  args[n++] = copy;
+  args[n] = NULL;
+  if ((sec = best_run( xdir, args, copy, edsk, nbe)) >= 0)
+    report( spec->name, "insert", sec, spec->used * 252.0, nnames);
+  free( edsk);
+
+// Deletion of the same files from the original image
+  n = 0;
+  args[n++] = "flwrite";
+  args[n++] = "-d";
+  for (k = 0; k < nnames; k++)
+    args[n++] = names[k];
+  args[n++] = copy;
+  args[n] = NULL;
+  if ((sec = best_run( dir, args, copy, dsk, nb)) >= 0)
+    report( spec->name, "delete", sec, 0, nnames);
+  for (k = 0; k < nnames; k++)
+    free( names[k]);
+  free( names);
+
+// Freelist repair and directory compaction
+  args[0] = "flan"; args[1] = "-q"; args[2] = "-r"; args[3] = copy; args[4] = NULL;
+  if ((sec = best_run( dir, args, copy, dsk, nb)) >= 0)
+    report( spec->name, "repair", sec, (double)nb * SECSIZE, 1);
+
+// Move to an image with twice the tracks (256 at most)
+  snprintf( xdir, sizeof( xdir), "-t%d", spec->nbtrk < 128 ? 2 * spec->nbtrk : 256);
+  args[0] = "flconvert"; args[1] = xdir; args[2] = image; args[3] = copy; args[4] = NULL;
+  if ((sec = best_run( dir, args, copy, NULL, 0)) >= 0)
+    report( spec->name, "remap", sec, spec->used * 252.0, spec->nfiles);
+
+// Manifest of the checksums of sectors and files
+  args[0] = "flsum"; args[1] = image; args[2] = NULL;
+  if ((sec = best_run( dir, args, copy, NULL, 0)) >= 0)
+    report( spec->name, "checksum", sec, (double)nb * SECSIZE, 1);
+
+// Formatting of an image of same geometry
+  snprintf( xdir, sizeof( xdir), "-t%d", spec->nbtrk);
+  snprintf( label, sizeof( label), "-s%d", spec->nbsec);
+  n = 0;
+  args[n++] = "flfmt";
+  args[n++] = xdir;
+  args[n++] = label;
+  if (spec->track0) {
+    args[n++] = "-d";
+    args[n] = malloc( 16);
+    sprintf( args[n++], "-f%d", spec->track0);
+  }
+  args[n++] = copy;
+  args[n] = NULL;
+  if ((sec = best_run( dir, args, copy, NULL, 0)) >= 0)
+    report( spec->name, "format", sec, (double)nb * SECSIZE, 1);
+  if (spec->track0)
+    free( args[4]);
+
+  unlink( copy);
+  unlink( strcat( copy, ".bak"));
+  if (!keep)
+    unlink( image);
+  rm_tree( dir);
+  free( args);
+}
+
+///////////////////////////////////////////////////////////
+// Worst cases: damaged images of growing size, the time //
+// and memory of the tools must grow like the image size //
+// Return 1 if a tool doesn't scale, or fails on one     //
+///////////////////////////////////////////////////////////
+
+#define NSIZES 4
+#define NREAD 50          // files asked to flread
+
+static int worst_trk[NSIZES] = { 32, 64, 128, 256 };
+
+static char *worst_op[] = { "analyse", "extract", "read" };
+#define NOPS (sizeof( worst_op) / sizeof( char *))
+
+static int bench_worst( void) {
+  char dir[128], image[132], xdir[160];
+  char *args[NREAD + 8];
+  char names[NREAD][16];
+  struct Genspec spec;
+  double sec[NOPS][NSIZES], best, t;
+  long rss[NOPS][NSIZES], mem;
+  struct rusage ru;
+  double grow;
+  uint8_t *dsk;
+  int nb[NSIZES];
+  int kind, sz, op, r, k, n;
+  int status, retval = 0;
+  pid_t pid;
+
+  printf( "%-19s", "CPU time, peak memory");
+  for (sz = 0; sz < NSIZES; sz++)
+    printf( " %15d sectors", worst_trk[sz] * 255);
+  putchar( '\n');
+
+  for (kind = 0; kind < NB_HOSTILE; kind++) {
+    for (sz = 0; sz < NSIZES; sz++) {
+      memset( &spec, 0, sizeof( spec));
+      spec.name = hostile_name[kind];
+      spec.nbtrk = worst_trk[sz];
+      spec.nbsec = 255;
+      spec.nfiles = worst_trk[sz] * 4;
+      spec.nrandom = spec.ndeleted = spec.nfiles / 10;
+      spec.fill = 80;
+      spec.frag = 30;
+      snprintf( dir, sizeof( dir), "%s/%s.%d", workdir, spec.name, sz);
+      snprintf( image, sizeof( image), "%s.dsk", dir);
+      mkdir( dir, 0755);
+// Built by a child: the peak memory of the tools, inherited
+// from flbench through fork(), must not include the image
+      if ((pid = fork()) == 0) {
+        dsk = gen_hostile( kind, &spec, SEED, &nb[sz]);
+        _exit( dsk == NULL || write_image( image, dsk, nb[sz]) ? 3 : 0);
+      }
+      if (pid < 0 || waitpid( pid, &status, 0) < 0 || !WIFEXITED( status) ||
+          WEXITSTATUS( status) != 0) {
+        fprintf( stderr, "%s: image not built\n", spec.name);
+        return 3;
+      }
+      nb[sz] = spec.nbsec + (spec.nbtrk - 1) * spec.nbsec;
+
+// Entries present at all the sizes
+      for (k = 0; k < NREAD; k++)
+        if (kind == H_DIRCHAIN)
+          snprintf( names[k], sizeof( names[k]), "D%07d.TXT", k * 2);
+        else
+          snprintf( names[k], sizeof( names[k]), "F%05d.TXT", k * 2);
+
+      for (op = 0; op < NOPS; op++) {
+        n = 0;
+        switch (op) {
+        case 0:
+          args[n++] = "flan"; args[n++] = "-q";
+          break;
+        case 1:
+          args[n++] = "fldump"; args[n++] = "-q"; args[n++] = "-a";
+          break;
+        case 2:
+          args[n++] = "flread"; args[n++] = "-o";
+          for (k = 0; k < NREAD; k++)
+            args[n++] = names[k];
+          break;
+        }
+        args[n++] = image;
+        args[n] = NULL;
+
+// Damaged images give errors: only a crash or a timeout fails
+// The CPU time is less disturbed than the elapsed time
+        best = -1;
+        mem = 0;
+        for (r = 0; r < 3; r++) {
+          snprintf( xdir, sizeof( xdir), "%s/x", dir);
+          rm_tree( xdir);
+          mkdir( xdir, 0755);
+          if (run( xdir, args, 126, &ru) < 0)
+            break;
+          t = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+              (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+          if (best < 0 || t < best)
+            best = t;
+          if (ru.ru_maxrss > mem)
+            mem = ru.ru_maxrss;
+        }
+        if (best < 0) {
+          printf( "%s/%s: %d sectors, FAIL\n", spec.name, worst_op[op], nb[sz]);
+          retval = 1;
+// Only the damaged files are lost: the others must be extracted,
+// else only the analyse would be timed (all the entries of the
+// directory chained through the disk are wrong)
+        } else if (op == 1 && kind != H_DIRCHAIN && count_files( xdir) == 0) {
+          printf( "%s/%s: %d sectors, no file extracted\n", spec.name, worst_op[op], nb[sz]);
+          retval = 1;
+        }
+        sec[op][sz] = best;
+        rss[op][sz] = mem;
+      }
+      if (!keep) {
+        unlink( image);
+        rm_tree( dir);
+      }
+    }
+
+// From the smallest to the biggest image, time and memory may
+// grow twice as fast as the size, not more
+    grow = 2.0 * nb[NSIZES-1] / nb[0];
+    for (op = 0; op < NOPS; op++) {
+      printf( "%-10s %-8s", spec.name, worst_op[op]);
+      for (sz = 0; sz < NSIZES; sz++)
+        if (sec[op][sz] < 0)
+          printf( " %23s", "failed");
+        else
+          printf( " %9.2f ms %7ld kB", sec[op][sz] * 1e3, rss[op][sz]);
+      t = sec[op][0] > 2e-3 ? sec[op][0] : 2e-3;
+      if (sec[op][0] >= 0 && sec[op][NSIZES-1] >= 0 &&
+          (sec[op][NSIZES-1] > grow * t || rss[op][NSIZES-1] > grow * rss[op][0])) {
+        printf( "  NOT LINEAR");
+        retval = 1;
+      }
+      putchar( '\n');
+    }
+  }
+  return retval;
+}
+
+////////////////////////////////////////////////////////
+// Converters: synthetic texts and S19 files, each    //
+// one converted by the library and by the tool, and  //
+// checked by a round trip                            //
+////////////////////////////////////////////////////////
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define cycles() __rdtsc()
+#else
+#define cycles() 0        // cycles/byte not measured
+#endif
+
+#define TEXTSIZE (4 << 20)
+
+static char *text_kind[] = { "tabs", "longlines", "spaces" };
+static char *s19_kind[] = { "dense", "sparse", "overlap" };
+
+static uint64_t conv_state = SEED;
+
+static uint32_t conv_rnd( void) {
+  conv_state ^= conv_state >> 12;
+  conv_state ^= conv_state << 25;
+  conv_state ^= conv_state >> 27;
+  return (conv_state * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+// Text of TEXTSIZE bytes: indented source, long lines or long runs of spaces
+
+static uint8_t *gen_text( int kind, size_t *len) {
+  uint8_t *buf, *p, *end;
+  int k, n;
+
+  buf = malloc( TEXTSIZE + 8192);
+  p = buf;
+  end = buf + TEXTSIZE;
+  while (p < end) {
+    switch (kind) {
+    case 0:                  // tabs before, between and after the words
+      for (n = conv_rnd() % 5; n > 0; n--)
+        *p++ = '\t';
+      for (n = 1 + conv_rnd() % 8; n > 0; n--) {
+        for (k = 2 + conv_rnd() % 8; k > 0; k--)
+          *p++ = 'a' + conv_rnd() % 26;
+        *p++ = conv_rnd() % 4 ? ' ' : '\t';
+      }
+      break;
+    case 1:                  // lines of 1000 to 4000 chars
+      for (n = 1000 + conv_rnd() % 3000; n > 0; n--)
+        *p++ = conv_rnd() % 6 ? 'a' + conv_rnd() % 26 : ' ';
+      break;
+    case 2:                  // runs of 50 to 400 spaces
+      for (n = 1 + conv_rnd() % 4; n > 0; n--) {
+        for (k = 50 + conv_rnd() % 350; k > 0; k--)
+          *p++ = ' ';
+        for (k = 1 + conv_rnd() % 10; k > 0; k--)
+          *p++ = 'A' + conv_rnd() % 26;
+      }
+      break;
+    }
+    *p++ = '\n';
+  }
+  *len = p - buf;
+  return buf;
+}
+
+// What flpack then flunpack must give: tabs expanded, no trailing space
+
+static uint8_t *expand_text( uint8_t *in, size_t len, size_t *outlen) {
+  uint8_t *out, *o, *eol;
+  size_t k;
+  int col;
+
+  out = malloc( len * 8 + 1);
+  o = eol = out;
+  col = 0;
+  for (k = 0; k < len; k++) {
+    if (in[k] == '\t') {
+      do {
+        *o++ = ' ';
+      } while (++col % 8);
+    } else if (in[k] == '\n') {
+      o = eol;
+      *o++ = '\n';
+      eol = o;
+      col = 0;
+    } else {
+      *o++ = in[k];
+      col++;
+      if (in[k] != ' ')
+        eol = o;
+    }
+  }
+  *outlen = o - out;
+  return out;
+}
+
+// S19 record of n bytes, return its length
+
+static int s19rec( char *o, char type, int addr, uint8_t *data, int n) {
+  int checksum, k, len;
+
+  checksum = n + 3 + (addr >> 8) + (addr & 0xFF);
+  len = sprintf( o, "S%c%02X%04X", type, n + 3, addr);
+  for (k = 0; k < n; k++) {
+    len += sprintf( o + len, "%02X", data[k]);
+    checksum += data[k];
+  }
+  return len + sprintf( o + len, "%02X\n", ~checksum & 0xFF);
+}
+
+// S19 files: the whole memory, small scattered records,
+// or the same areas written again and again
+
+static char *gen_s19( int kind, size_t *len) {
+  uint8_t data[32];
+  char *buf, *p;
+  int addr, n, k, pass;
+
+  buf = malloc( 4 << 20);
+  p = buf;
+  switch (kind) {
+  case 0:
+    for (addr = 0; addr < 0x10000; addr += 16) {
+      for (k = 0; k < 16; k++)
+        data[k] = conv_rnd();
+      p += s19rec( p, '1', addr, data, 16);
+    }
+    break;
+  case 1:
+    p += s19rec( p, '0', 0, (uint8_t *)"SPARSE", 6);
+    for (k = 0; k < 4000; k++) {
+      n = 1 + conv_rnd() % 8;
+      addr = conv_rnd() % (0x10000 - n);
+      for (pass = 0; pass < n; pass++)
+        data[pass] = conv_rnd();
+      p += s19rec( p, '1', addr, data, n);
+    }
+    break;
+  case 2:
+    for (pass = 0; pass < 40; pass++) {
+      addr = conv_rnd() % 0x4000;
+      for (k = 0; k < 2048; k++, addr += 16) {
+        for (n = 0; n < 16; n++)
+          data[n] = conv_rnd();
+        p += s19rec( p, '1', addr, data, 16);
+      }
+    }
+    break;
+  }
+  p += s19rec( p, '9', 0x1000, NULL, 0);
+  *len = p - buf;
+  return buf;
+}
+
+// Buffers of the conversion being timed
+
+static uint8_t *cv_in, *cv_out;
+static size_t cv_len, cv_outlen;
+
+static void do_pack( void) {
+  struct Textconv tc;
+
+  text_init( &tc, 8);
+  cv_outlen = pack_text( &tc, cv_in, cv_len, cv_out);
+}
+
+static void do_unpack( void) {
+  struct Textconv tc;
+  size_t k, n;
+
+  text_init( &tc, 8);
+  cv_outlen = 0;
+  for (k = 0; k < cv_len; k += n) {   // output can't be bigger than UNPACK_MAX
+    n = cv_len - k < 4096 ? cv_len - k : 4096;
+    cv_outlen += unpack_text( &tc, cv_in + k, n, cv_out + cv_outlen);
+  }
+}
+
+static void do_s19( void) {
+  int line;
+
+  if (s19_to_cmd( (char *)cv_in, cv_len, cv_out, &cv_outlen, &line, NULL))
+    cv_outlen = 0;
+}
+
+static void do_cmd( void) {
+  if (cmd_to_s19( cv_in, cv_len, (char *)cv_out, &cv_outlen))
+    cv_outlen = 0;
+}
+
+///////////////////////////////////////////////////////
+// Time a conversion of in to out, repeated until    //
+// 0.2s are spent. The result stays in out, outlen   //
+///////////////////////////////////////////////////////
+
+static void time_conv( char *wname, char *op, void (*conv)( void),
+                       uint8_t *in, size_t len, uint8_t *out, size_t *outlen) {
+  struct Result *r;
+  double start, sec;
+  uint64_t c0;
+  int reps = 0;
+
+  cv_in = in;
+  cv_len = len;
+  cv_out = out;
+  start = now();
+  c0 = cycles();
+  do {
+    conv();
+    reps++;
+  } while ((sec = now() - start) < 0.2);
+  sec /= reps;
+  r = add_result( wname, op, sec, (double)len, 1);
+  printf( "%-24s %10.3f ms %10.2f MB/s", r->name, sec * 1e3, r->mbs);
+  if (c0 != cycles())
+    printf( " %8.2f cycles/B", (double)(cycles() - c0) / reps / len);
+  putchar( '\n');
+  *outlen = cv_outlen;
+}
+
+// Write a buffer in a file of the work directory
+
+static char *conv_file( char *name, void *buf, size_t len) {
+  static char path[4][128];
+  static int n = 0;
+  FILE *out;
+  char *p;
+
+  p = path[n++ % 4];
+  snprintf( p, 128, "%s/%s", workdir, name);
+  if ((out = fopen( p, "wb")) == NULL) {
+    perror( p);
+    return p;
+  }
+  fwrite( buf, 1, len, out);
+  fclose( out);
+  return p;
+}
+
+// Compare a file of the work directory to a buffer
+
+static int same_file( char *path, void *buf, size_t len) {
+  struct stat st;
+  uint8_t *data;
+  FILE *in;
+  int same;
+
+  if (stat( path, &st) || st.st_size != len || (in = fopen( path, "rb")) == NULL)
+    return 0;
+  data = malloc( len + 1);
+  same = fread( data, 1, len, in) == len && memcmp( data, buf, len) == 0;
+  fclose( in);
+  free( data);
+  return same;
+}
+
+// Best time of REPS runs of a converter tool
+
+static void time_tool( char *wname, char *op, char **args, size_t len) {
+  double sec, best = -1;
+  int r;
+
+  for (r = 0; r < REPS; r++) {
+    if ((sec = run( workdir, args, 0, NULL)) < 0)
+      return;
+    if (best < 0 || sec < best)
+      best = sec;
+  }
+  report( wname, op, best, (double)len, 1);
+}
+
+static int check( char *what, int ok) {
+  if (!ok)
+    printf( "%-24s round trip FAILED\n", what);
+  return !ok;
+}
+
+static int bench_convert( void) {
+  uint8_t *text, *ref, *flex, *plain;
+  char *s19, *back, name[32];
+  uint8_t *cmd, *cmd2;
+  size_t len, reflen, flexlen, plainlen, cmdlen, cmd2len, backlen;
+  char *args[4], *in, *out;
+  struct Textconv tc;
+  int kind, retval = 0;
+
+  for (kind = 0; kind < 3; kind++) {
+    text = gen_text( kind, &len);
+    ref = expand_text( text, len, &reflen);
+    text_init( &tc, 8);
+    flex = malloc( PACK_MAX( &tc, len));
+    plain = malloc( reflen + UNPACK_MAX( 4096));
+    printf( "%s: %zu bytes of text\n", text_kind[kind], len);
+
+    time_conv( text_kind[kind], "pack", do_pack, text, len, flex, &flexlen);
+    time_conv( text_kind[kind], "unpack", do_unpack, flex, flexlen, plain, &plainlen);
+    snprintf( name, sizeof( name), "%s/lib", text_kind[kind]);
+    retval |= check( name, plainlen == reflen && memcmp( plain, ref, reflen) == 0);
+
+// The tools, from file to file
+    in = conv_file( "text.txt", text, len);
+    out = conv_file( "text.flx", "", 0);
+    args[0] = "flpack"; args[1] = in; args[2] = out; args[3] = NULL;
+    time_tool( text_kind[kind], "flpack", args, len);
+    in = out;
+    out = conv_file( "text.out", "", 0);
+    args[0] = "flunpack"; args[1] = in; args[2] = out;
+    time_tool( text_kind[kind], "flunpack", args, flexlen);
+    snprintf( name, sizeof( name), "%s/tools", text_kind[kind]);
+    retval |= check( name, same_file( in, flex, flexlen) && same_file( out, ref, reflen));
+    free( text);
+    free( ref);
+    free( flex);
+    free( plain);
+  }
+
+  for (kind = 0; kind < 3; kind++) {
+    s19 = gen_s19( kind, &len);
+    cmd = malloc( CMD_MAX( len));
+    printf( "%s: %zu bytes of S19\n", s19_kind[kind], len);
+
+    time_conv( s19_kind[kind], "s19tocmd", do_s19, (uint8_t *)s19, len, cmd, &cmdlen);
+    back = malloc( S19_MAX( cmdlen));
+    time_conv( s19_kind[kind], "cmdtos19", do_cmd, cmd, cmdlen, (uint8_t *)back, &backlen);
+
+// The .CMD of the S19 given back must be the same, and for a
+// S19 already in the form given by cmd_to_s19(), the S19 too
+    cmd2 = malloc( CMD_MAX( backlen));
+    cv_in = (uint8_t *)back;
+    cv_len = backlen;
+    cv_out = cmd2;
+    do_s19();
+    cmd2len = cv_outlen;
+    snprintf( name, sizeof( name), "%s/lib", s19_kind[kind]);
+    retval |= check( name, cmdlen > 0 && cmd2len == cmdlen && memcmp( cmd, cmd2, cmdlen) == 0 &&
+                     (kind != 0 || (backlen == len && memcmp( back, s19, len) == 0)));
+
+    in = conv_file( "prog.s19", s19, len);
+    out = conv_file( "prog.cmd", "", 0);
+    args[0] = "mot2cmd"; args[1] = in; args[2] = out; args[3] = NULL;
+    time_tool( s19_kind[kind], "mot2cmd", args, len);
+    snprintf( name, sizeof( name), "%s/tool", s19_kind[kind]);
+    retval |= check( name, same_file( out, cmd, cmdlen));
+    free( s19);
+    free( cmd);
+    free( cmd2);
+    free( back);
+  }
+  return retval;
+}
+
+// Save the results in a baseline file
+
+static int save_baseline( char *path) {
+  FILE *out;
+  int k;
+
+  if ((out = fopen( path, "w")) == NULL) {
+    perror( path);
+    return 3;
+  }
+  for (k = 0; k < nres; k++)
+    fprintf( out, "%s %.3f %.3f\n", result[k].name, result[k].mbs, result[k].ops);
+  fclose( out);
+  return 0;
+}
+
+//////////////////////////////////////////////////////
+// Compare the results with a baseline file         //
+// Return 1 if an operation is slower than accepted //
+//////////////////////////////////////////////////////
+
+static int compare_baseline( char *path, double tolerance) {
+  FILE *in;
+  char name[32];
+  double mbs, ops, delta;
+  int k, retval = 0;
+
+  if ((in = fopen( path, "r")) == NULL) {
+    perror( path);
+    return 3;
+  }
+  printf( "\nCompared to %s:\n", path);
+  while (fscanf( in, "%31s %lf %lf", name, &mbs, &ops) == 3) {
+    for (k = 0; k < nres; k++)
+      if (strcmp( result[k].name, name) == 0)
+        break;
+    if (k == nres || ops <= 0)
+      continue;
+    delta = (result[k].ops - ops) * 100 / ops;
+    printf( "%-24s %+8.1f %%", name, delta);
+    if (delta < -tolerance) {
+      printf( "  SLOWER");
+      retval = 1;
+    }
+    putchar( '\n');
+  }
+  fclose( in);
+  return retval;
+}
+
+// Program start here
+int main( int argc, char **argv)
+{
+  static struct option longopts[] = { STATS_OPTION, { 0, 0, 0, 0 } };
+  int opt;
+  int quick = 0, worst = 0, convert = 0;
+  char *save = NULL, *compare = NULL;
+  double tolerance = 20;
+  char image[128], *p;
+  struct Genspec spec;
+  uint8_t *dsk;
+  int nb, k, i;
+  int retval = 0;
+
+  while ((opt = getopt_long( argc, argv, "hkqs:c:t:wx", longopts, NULL)) != -1) {
+	switch (opt) {
+	case 'h':
+	  usage( *argv);
+	  exit( 0);
+	  break;
+	case 'k':
+	  keep = 1;
+	  break;
+	case 'q':
+	  quick = 1;
+	  break;
+	case 's':
+	  save = optarg;
+	  break;
+	case 'c':
+	  compare = optarg;
+	  break;
+	case 't':
+	  tolerance = atof( optarg);
+	  break;
+	case 'w':
+	  worst = 1;
+	  break;
+	case 'x':
+	  convert = 1;
+	  break;
+	case 'S':
+	  stats_init( *argv, optarg);
+	  break;
+	default: /* '?' */
+	  usage( *argv);
+	  exit( 3);
+	}
+  }
+
+// The tools are looked for next to flbench
+  if (realpath( argv[0], tooldir) == NULL) {
+    perror( argv[0]);
+    exit( 3);
+  }
+  if ((p = strrchr( tooldir, '/')) != NULL)
+    *p = 0;
+
+  strcpy( workdir, "/tmp/flbench.XXXXXX");
+  if (mkdtemp( workdir) == NULL) {
+    perror( workdir);
+    exit( 3);
+  }
+
+  if (worst) {
+    retval = bench_worst();
+    if (keep)
+      printf( "\nImages kept in %s\n", workdir);
+    else
+      rm_tree( workdir);
+    return retval;
+  }
+
+  for (k = 0; !convert && workload[k].name != NULL; k++) {
+    if (optind < argc) {       // only the workloads asked for
+      for (i = optind; i < argc; i++)
+        if (strcmp( argv[i], workload[k].name) == 0)
+          break;
+      if (i == argc)
+        continue;
+    } else if (quick && workload[k].nbtrk * workload[k].nbsec > 80 * 36)
+      continue;
+
+    spec = workload[k];
+    if ((dsk = gen_image( &spec, SEED, &nb)) == NULL) {
+      fprintf( stderr, "%s: bad workload\n", spec.name);
+      continue;
+    }
+    snprintf( image, sizeof( image), "%s/%s.dsk", workdir, spec.name);
+    if (write_image( image, dsk, nb)) {
+      free( dsk);
+      continue;
+    }
+    printf( "%s: %d sectors, %d files (%d random), %d deleted, %d sectors used\n",
+      spec.name, nb, spec.nfiles, spec.nrandom, spec.ndeleted, spec.used);
+
+    bench_analyse( &spec, image);
+    bench_tools( &spec, image, dsk, nb);
+    free( dsk);
+  }
+
+  if (convert)
+    retval = bench_convert();
+
+  if (keep)
+    printf( "\nImages kept in %s\n", workdir);
+  else
+    rm_tree( workdir);
+
+  if (save)
+    retval = save_baseline( save);
+  if (compare)
+    retval |= compare_baseline( compare, tolerance);
+  return retval;
+}
@@ -0,0 +1,386 @@
+/* flcache.c -- Flex image analyse cache
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+// The result of analyse() is saved in a cache file if the environment
+// variable FLCACHE is set: in the directory it names, or next to the
+// image (image name + ".flc") if it is empty.
+// The cache is only used if the image has the same size, inode,
+// modification and change times (and its base image the same change
+// time, for an overlay), and the same boot sectors and SIR, as when it
+// was created: the image is not read to validate it. A change in the
+// second the cache was written may not change the times, the cache then
+// also keeps a hash of the whole image, verified when it is used.
+
+#define CACHE_MAGIC "FLCACHE5"   // 5: a bad sequence no more counts in retval
+
+struct Cache {
+    char magic[8];       // CACHE_MAGIC
+    uint32_t filesize;   // sizeof( struct File), to detect layout changes
+    uint32_t size;       // Size of the image in bytes
+    int64_t mtime;       // Modification time of the image
+    int64_t mtime_ns;
+    int64_t ctime;       // Change time, that can't be set back
+    int64_t ctime_ns;
+    uint64_t ino;        // Inode of the image
+    int64_t base_ctime;  // Change time of the base image of an overlay
+    int64_t base_ctime_ns;
+    uint64_t hash;       // hash64() of the boot sectors and SIR
+    uint64_t full;       // hash64() of the whole image if written in the
+                         // second of its last change, else 0
+    uint64_t sum;        // hash64() of the tables that follow
+    int retval;          // value returned by analyse()
+    int nfile, nslot, usedsec, notused, notdir, ndel;
+    uint8_t lasttrk, lastsec;
+    uint16_t nb_sectors; // size of tabsec and nxtsec
+};
+
+////////////////////////////////////////////////////
+// Finaliser of MurmurHash3: each bit of the      //
+// result depends on all the bits of h            //
+////////////////////////////////////////////////////
+
+uint64_t mix64( uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// A 64 bits word mixed in the hash h
+
+static uint64_t mix_word( uint64_t h, uint64_t w) {
+  w *= 0x87c37b91114253d5ULL;
+  w = (w << 31) | (w >> 33);
+  w *= 0x4cf5ad432745937fULL;
+  h ^= w;
+  return ((h << 27) | (h >> 37)) * 5 + 0x52dce729;
+}
+
+////////////////////////////////////////////////////
+// Fast 64 bits hash, a word at a time as in      //
+// MurmurHash3: a multiply alone only carries the //
+// changes of a word to its higher bits, the      //
+// rotations bring them back to the lower ones    //
+////////////////////////////////////////////////////
+
+uint64_t hash64( uint8_t *buf, size_t len) {
+  uint64_t h = 0xcbf29ce484222325ULL ^ len;
+  uint64_t w;
+  size_t i;
+
+  for (i = 0; i + 8 <= len; i += 8) {
+    memcpy( &w, buf + i, 8);
+    h = mix_word( h, w);
+  }
+  if (i < len) {
+    w = 0;
+    memcpy( &w, buf + i, len - i);
+    h = mix_word( h, w);
+  }
+  return mix64( h);
+}
+
+/////////////////////////////////////////////////////
+// Name of the cache file of an image, NULL if the //
+// cache is not used                               //
+/////////////////////////////////////////////////////
+
+static char *cache_path( char *filepath) {
+  static char path[PATH_MAX + 64];
+  char full[PATH_MAX];
+  char *dir;
+
+  if ((dir = getenv( "FLCACHE")) == NULL)
+    return NULL;
+  if (*dir == 0) {
+    snprintf( path, sizeof( path), "%s.flc", filepath);
+    return path;
+  }
+  if (realpath( filepath, full) == NULL)
+    return NULL;
+  snprintf( path, sizeof( path), "%s/%s.%016llx.flc", dir, disk.shortname,
+    (unsigned long long)hash64( (uint8_t *)full, strlen( full)));
+  return path;
+}
+
+////////////////////////////////////////////////////
+// What identifies the image: its size, inode and  //
+// times, and the hash of its first 3 sectors,     //
+// always in memory                                //
+// Return -1 if the image can't be stat'ed          //
+////////////////////////////////////////////////////
+
+static int cache_key( char *filepath, struct Cache *key) {
+  struct stat st;
+
+  memset( key, 0, sizeof( struct Cache));
+  flstat.syscalls++;
+  if (stat( filepath, &st))
+    return -1;
+  key->size = st.st_size;
+  key->mtime = st.st_mtim.tv_sec;
+  key->mtime_ns = st.st_mtim.tv_nsec;
+  key->ctime = st.st_ctim.tv_sec;
+  key->ctime_ns = st.st_ctim.tv_nsec;
+  key->ino = st.st_ino;
+  if (disk.base != NULL) {
+    flstat.syscalls++;
+    if (stat( disk.base, &st))
+      return -1;
+    key->base_ctime = st.st_ctim.tv_sec;
+    key->base_ctime_ns = st.st_ctim.tv_nsec;
+  }
+  key->hash = hash64( disk.dsk, 3 * SECSIZE);
+  return 0;
+}
+
+// Changed in this second: the times may not change with a new write
+
+static int racy( struct Cache *key) {
+  time_t now = time( NULL);
+
+  return now <= key->ctime + 1 || (key->base_ctime && now <= key->base_ctime + 1);
+}
+
+/////////////////////////////////////////////////////
+// Verify the tables read from a cache file: they  //
+// are used as indexes in the image and the tables //
+// Return 0 if OK, -1 if not                       //
+/////////////////////////////////////////////////////
+
+static int check_tables( struct File *tfile, int nb, int *ttab, int *tnxt) {
+  int k;
+
+  for (k = 0; k < nb; k++)
+    if ((uintptr_t)tfile[k].pos > disk.size - 24 || tfile[k].name[15] != 0
+        || tfile[k].length < 0 || tfile[k].length > 0xFFFF)
+      return -1;
+  for (k = 0; k < disk.nb_sectors; k++)
+    if (ttab[k] < -99999 || ttab[k] > nb || tnxt[k] < 0 || tnxt[k] >= disk.nb_sectors)
+      return -1;
+  return 0;
+}
+
+/////////////////////////////////////////////////////
+// Restore the analyse tables from the cache, if   //
+// it is the one of the image identified by key    //
+// Return the analyse() value, or -1 if no cache   //
+/////////////////////////////////////////////////////
+
+static int load_cache( char *filepath, struct Cache *key, struct Cache *head) {
+  struct stat st;
+  uint8_t *buf;
+  char *path;
+  int fd, k;
+  size_t len, flen;
+
+  if ((path = cache_path( filepath)) == NULL)
+    return -1;
+  flstat.syscalls++;
+  if ((fd = open( path, O_RDONLY)) < 0)
+    return -1;
+
+  flstat.syscalls += 2;
+  if (read( fd, head, sizeof( struct Cache)) != sizeof( struct Cache) ||
+      memcmp( head->magic, CACHE_MAGIC, 8) != 0 ||
+      head->filesize != sizeof( struct File) ||
+      head->size != key->size ||
+      head->nb_sectors != disk.nb_sectors ||
+      head->mtime != key->mtime ||
+      head->mtime_ns != key->mtime_ns ||
+      head->ctime != key->ctime ||
+      head->ctime_ns != key->ctime_ns ||
+      head->ino != key->ino ||
+      head->base_ctime != key->base_ctime ||
+      head->base_ctime_ns != key->base_ctime_ns ||
+      head->hash != key->hash ||
+      head->nslot < 0 || head->nslot > disk.nb_sectors * 10 ||
+      fstat( fd, &st) < 0) {
+    close( fd);
+    return -1;
+  }
+  flen = sizeof( struct File) * head->nslot;
+  len = flen + 2 * sizeof( int) * disk.nb_sectors;
+  if (st.st_size != sizeof( struct Cache) + len || (buf = malloc( len + 1)) == NULL) {
+    close( fd);
+    return -1;
+  }
+  flstat.syscalls += 2;     // read and close
+  if (read( fd, buf, len) != len || hash64( buf, len) != head->sum ||
+      check_tables( (struct File *)buf, head->nslot, (int *)(buf + flen),
+                    (int *)(buf + flen) + disk.nb_sectors)) {
+    close( fd);
+    free( buf);
+    return -1;
+  }
+  close( fd);
+  flstat.rbytes += sizeof( struct Cache) + len;
+
+// Written just after a change of the image: its content is compared
+  if (head->full != 0 && (load_all() || hash64( disk.dsk, disk.size) != head->full)) {
+    free( buf);
+    return -1;
+  }
+
+  file = calloc( head->nslot + 1, sizeof( struct File));
+  tabsec = malloc( sizeof( int) * disk.nb_sectors);
+  nxtsec = malloc( sizeof( int) * disk.nb_sectors);
+  if (file == NULL || tabsec == NULL || nxtsec == NULL) {
+    free( buf);
+    return -1;
+  }
+  memcpy( file, buf, flen);
+  memcpy( tabsec, buf + flen, sizeof( int) * disk.nb_sectors);
+  memcpy( nxtsec, buf + flen + sizeof( int) * disk.nb_sectors, sizeof( int) * disk.nb_sectors);
+  free( buf);
+
+// Entries were saved as offsets in the image, whose directory
+// sectors must be read if it is partially loaded
+  for (k = 0; k < head->nslot; k++)
+    file[k].pos = getsec( (uintptr_t)file[k].pos / SECSIZE) + (uintptr_t)file[k].pos % SECSIZE;
+
+  nfile = head->nfile;
+  nslot = head->nslot;
+  usedsec = head->usedsec;
+  notused = head->notused;
+  notdir = head->notdir;
+  ndel = head->ndel;
+  lasttrk = head->lasttrk;
+  lastsec = head->lastsec;
+  return head->retval;
+}
+
+///////////////////////////////////////////////////////
+// Save the analyse tables in the cache, for the     //
+// image identified by key (with the hash of its    //
+// content if it was just changed)                   //
+///////////////////////////////////////////////////////
+
+static void save_cache( char *filepath, struct Cache *key, int retval) {
+  struct Cache head;
+  struct File *entry;
+  char *path, tmp[PATH_MAX + 72];
+  uint8_t *buf;
+  size_t len, flen;
+  FILE *out;
+  int k;
+
+  if ((path = cache_path( filepath)) == NULL)
+    return;
+  flen = sizeof( struct File) * nslot;
+  len = flen + 2 * sizeof( int) * disk.nb_sectors;
+  if ((buf = malloc( len + 1)) == NULL)
+    return;
+  entry = (struct File *)buf;
+  for (k = 0; k < nslot; k++) {
+    entry[k] = file[k];
+    entry[k].pos = (uint8_t *)(uintptr_t)(file[k].pos - disk.dsk);
+  }
+  memcpy( buf + flen, tabsec, sizeof( int) * disk.nb_sectors);
+  memcpy( buf + flen + sizeof( int) * disk.nb_sectors, nxtsec, sizeof( int) * disk.nb_sectors);
+
+  head = *key;
+  memcpy( head.magic, CACHE_MAGIC, 8);
+  head.filesize = sizeof( struct File);
+  head.sum = hash64( buf, len);
+  head.retval = retval;
+  head.nfile = nfile;
+  head.nslot = nslot;
+  head.usedsec = usedsec;
+  head.notused = notused;
+  head.notdir = notdir;
+  head.ndel = ndel;
+  head.lasttrk = lasttrk;
+  head.lastsec = lastsec;
+  head.nb_sectors = disk.nb_sectors;
+
+  snprintf( tmp, sizeof( tmp), "%s.tmp", path);
+  if ((out = fopen( tmp, "wb")) == NULL) {
+    free( buf);
+    return;
+  }
+  fwrite( &head, sizeof( head), 1, out);
+  fwrite( buf, 1, len, out);
+  free( buf);
+  flstat.wbytes += ftell( out);
+  if (fclose( out) == 0)
+    rename( tmp, path);
+  else
+    unlink( tmp);
+}
+
+/////////////////////////////////////////////////////
+// analyse() with the cache: a valid cache is used //
+// if the image was clean, or if nothing has to be //
+// printed nor modified, else analyse() is run on  //
+// the whole image, read if it was partially       //
+// Return the value of analyse(), 3 if the image   //
+// can't be read                                   //
+/////////////////////////////////////////////////////
+
+int analyse_cached( char *filepath, int strict) {
+  struct Cache key, head;
+  int retval;
+
+  if (getenv( "FLCACHE") == NULL || cache_key( filepath, &key))
+    return load_all() ? 3 : analyse( strict);
+
+  stat_start( PH_ANALYSE);
+  retval = load_cache( filepath, &key, &head);
+  if (retval == 0 || (retval > 0 && quiet && disk.readonly)) {
+// Verified by its content: no more needed once the second is over
+    if (head.full != 0 && !racy( &key))
+      save_cache( filepath, &key, retval);
+    stat_stop( PH_ANALYSE);
+    return retval;
+  }
+  if (retval > 0) {        // diagnostics needed, start again
+    free( file);
+    free( tabsec);
+    free( nxtsec);
+    file = NULL;
+    tabsec = nxtsec = NULL;
+  }
+
+  if (load_all()) {
+    stat_stop( PH_ANALYSE);
+    return 3;
+  }
+// Hash before analyse(), which may sanitize the image
+  if (racy( &key))
+    key.full = hash64( disk.dsk, disk.size) | 1;
+  retval = analyse( strict);
+  if (tabsec != NULL && nxtsec != NULL && file != NULL)
+    save_cache( filepath, &key, retval);
+  stat_stop( PH_ANALYSE);
+  return retval;
+}
+
+//////////////////////////////////////////////
+// Remove the cache of a modified image     //
+//////////////////////////////////////////////
+
+void drop_cache( char *filepath) {
+  char *path;
+
+  if ((path = cache_path( filepath)) != NULL)
+    unlink( path);
+}
@@ -0,0 +1,354 @@
+/* flcarve.c -- Recover deleted and lost files from the orphan sectors
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+int verbose = 0; // more details when verbose increase
+int quiet = 1;   // by default don't give disk infos
+
+char *s_err = "",   // If color is supported => errmsg in red
+     *s_warn = "",  // warnings in yellow
+     *s_norm = "";  // return to normal
+
+// Orphan sector: in the free list or used by no file, indexed by
+// its sequence number (bytes 2-3), then by its place on the disk
+
+struct Orphan {
+  int seq;
+  int blk;
+};
+
+// Chain rebuilt from the orphans
+
+struct Chain {
+  int head;          // first bloc
+  int n;             // number of sectors
+  int seq;           // sequence number of the first data sector
+  int guessed;       // links guessed, not found in the sectors
+  int random;        // starts with the two sectors of a map
+  int entry;         // deleted directory entry matching it, or -1
+  int score;         // confidence, in percent
+};
+
+static struct Orphan *orph;
+static int norph;
+static int *succ, *pred;     // chains rebuilt, -1 if none
+static uint8_t *guess;       // 1 if the link to succ is guessed
+static int *delent;          // deleted entry starting at a bloc, or -1
+
+void usage( char *cmd) {
+	fprintf( stderr, "Usage: %s [-h] => this help\n", cmd);
+	fprintf( stderr, "       %s [-l] [-v] [-d dir] [-m score] <disk image>\n", cmd);
+    fprintf( stderr, "Options:\n");
+	fprintf( stderr, "   -d <dir> => directory for the files (default <image>.carved)\n");
+	fprintf( stderr, "   -l => list the files found, don't write them\n");
+	fprintf( stderr, "   -m <score> => only files with at least this confidence (%%)\n");
+	fprintf( stderr, "   -v => print details about the disk image\n");
+	fprintf( stderr, "   --stats[=json] => print timings and counters on stderr\n");
+}
+
+static int seqof( int ibloc) {
+  return disk.dsk[ibloc*SECSIZE+2] * 256 + disk.dsk[ibloc*SECSIZE+3];
+}
+
+static int is_orphan( int ibloc) {
+  return ibloc >= disk.track0l && ibloc < disk.nb_sectors && tabsec[ibloc] < 0;
+}
+
+static int cmp_orphan( const void *a, const void *b) {
+  const struct Orphan *x = a, *y = b;
+
+  if (x->seq != y->seq)
+    return x->seq - y->seq;
+  return x->blk - y->blk;
+}
+
+// Index of the first orphan not before (seq, blk)
+
+static int lower_bound( int seq, int blk) {
+  int lo = 0, hi = norph, mid;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (orph[mid].seq < seq || (orph[mid].seq == seq && orph[mid].blk < blk))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static void join( int a, int b, int guessed) {
+  succ[a] = b;
+  pred[b] = a;
+  guess[a] = guessed;
+}
+
+/////////////////////////////////////////////////////////////
+// Rebuild the chains of the orphan sectors. Links found   //
+// in the sectors are kept when the sequence numbers       //
+// follow, and the two map sectors of a random file when   //
+// the map points to the first data sector. A link that    //
+// was overwritten (not 0/0) is guessed: the orphan of     //
+// next sequence number nearest on the disk, if not taken. //
+// Sorting and binary searches make it O(n log n).         //
+/////////////////////////////////////////////////////////////
+
+static void rebuild_chains( void) {
+  struct Orphan *o;
+  int a, b, c, s, i, j, best;
+
+  for (i = 0; i < norph; i++) {
+    a = orph[i].blk;
+    b = nxtsec[a];
+    flstat.hops++;
+    if (orph[i].seq == 0) {      // map sectors, numbered 0
+      if (is_orphan( b) && seqof( b) == 0 && pred[b] < 0 && is_orphan( c = nxtsec[b])
+          && seqof( c) == 1 && pred[c] < 0 && succ[b] < 0
+          && ts2blk( disk.dsk[a*SECSIZE+4], disk.dsk[a*SECSIZE+5]) == c) {
+        join( a, b, 0);
+        join( b, c, 0);
+      }
+    } else if (is_orphan( b) && seqof( b) == orph[i].seq + 1 && pred[b] < 0)
+      join( a, b, 0);
+  }
+
+  for (i = 0; i < norph; i++) {
+    o = &orph[i];
+    a = o->blk;
+    if (o->seq == 0 || succ[a] >= 0 || nxtsec[a] == 0)
+      continue;
+    s = o->seq + 1;
+    j = lower_bound( s, a);
+    best = -1;
+    if (j < norph && orph[j].seq == s && pred[orph[j].blk] < 0)
+      best = orph[j].blk;
+    if (j > 0 && orph[j-1].seq == s && pred[orph[j-1].blk] < 0
+        && (best < 0 || a - orph[j-1].blk < best - a))
+      best = orph[j-1].blk;
+    if (best >= 0)
+      join( a, best, 1);
+  }
+}
+
+//////////////////////////////////////////////////////////
+// Confidence of a chain: the share of links found in   //
+// the sectors, halved if its first sectors are missing //
+// (the first sequence number is not 1), 100% if a      //
+// deleted directory entry gives the same start and     //
+// length                                               //
+//////////////////////////////////////////////////////////
+
+static void score( struct Chain *c) {
+  if ((c->entry = delent[c->head]) >= 0 && file[c->entry].length == c->n) {
+    c->score = 100;
+    return;
+  }
+  c->entry = -1;
+  c->score = 100 * (c->n - c->guessed) / c->n;
+  if (c->seq != 1)
+    c->score /= 2;
+}
+
+// Write the payload of a chain in dir, as fldump would
+
+static int write_chain( struct Chain *c, char *dir, char *name) {
+  char path[PATH_MAX];
+  uint8_t *buf, *o;
+  int fd, ibloc, j, len;
+
+  if (snprintf( path, sizeof( path), "%s/%s", dir, name) >= sizeof( path)) {
+    fprintf( stderr, "%s/%s: path too long\n", dir, name);
+    return 3;
+  }
+  if ((buf = malloc( c->n * (SECSIZE - 4) + 12)) == NULL) {
+    perror( "malloc: ");
+    return 3;
+  }
+  o = buf;
+  j = 4;
+  if (c->random) {
+    memcpy( o, "#FLEX##RAND#", 12);
+    o += 12;
+    j = 16;
+  }
+  for (ibloc = c->head; ibloc >= 0; ibloc = succ[ibloc]) {
+    memcpy( o, disk.dsk + ibloc * SECSIZE + j, SECSIZE - j);
+    o += SECSIZE - j;
+    j = 4;
+  }
+  len = o - buf;
+  if ((fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0 || write( fd, buf, len) != len) {
+    perror( path);
+    free( buf);
+    return 3;
+  }
+  close( fd);
+  free( buf);
+  flstat.wbytes += len;
+  flstat.syscalls += 3;
+  return 0;
+}
+
+// Program start here
+int main( int argc, char **argv)
+{
+  char *term, *getenv( const char *name);
+  static struct option longopts[] = { STATS_OPTION, { 0, 0, 0, 0 } };
+  int opt;
+  char *filepath, *dir = NULL;
+  char dirname[PATH_MAX], name[32];
+  struct Chain *chain;
+  int nchain, list = 0, minscore = 0;
+  int retval, werr = 0, found, ibloc, k;
+
+  while ((opt = getopt_long( argc, argv, "hlvd:m:", longopts, NULL)) != -1) {
+	switch (opt) {
+	case 'h':
+	  usage( *argv);
+	  exit( 0);
+	  break;
+	case 'l':
+	  list = 1;
+	  break;
+	case 'v':
+	  verbose = 1;
+	  quiet = 0;
+	  break;
+	case 'd':
+	  dir = optarg;
+	  break;
+	case 'm':
+	  minscore = atoi( optarg);
+	  break;
+	case 'S':
+	  stats_init( *argv, optarg);
+	  break;
+	default: /* '?' */
+	  usage( *argv);
+	  exit( 3);
+	}
+  }
+
+  if (argc - optind != 1) {
+	usage( *argv);
+	exit( 3);
+  }
+  filepath = argv[optind];
+
+// If possible, colorize Warnings and Errors
+  if (isatty( 1) && (term = getenv( "TERM")) != NULL) {
+    if (strstr( term, "256color") != NULL) {
+      s_warn = "\e[1;93m";
+      s_err  = "\e[1;91m";
+      s_norm = "\e[0m";
+    }
+  }
+
+  disk.readonly = 1;
+  if (load_image( filepath, 0))
+	exit( 3);
+  if (! isFlex( disk.dsk, disk.nb_sectors))
+	exit( 2);
+  retval = badFlex( 0);
+  if (retval > 1 && retval != 257)
+	return retval;
+// Damaged images are what we are here for: only give up if the directory loops
+  if ((retval = analyse_cached( filepath, 0)) > 2)
+	return retval;
+
+// Index of the orphan sectors
+  stat_start( PH_EXTRACT);
+  orph = malloc( sizeof( struct Orphan) * disk.nb_sectors);
+  succ = malloc( sizeof( int) * disk.nb_sectors);
+  pred = malloc( sizeof( int) * disk.nb_sectors);
+  guess = calloc( disk.nb_sectors, 1);
+  delent = malloc( sizeof( int) * disk.nb_sectors);
+  chain = malloc( sizeof( struct Chain) * disk.nb_sectors);
+  if (orph == NULL || succ == NULL || pred == NULL || guess == NULL || delent == NULL
+      || chain == NULL) {
+	perror( "malloc: ");
+	exit( 3);
+  }
+  norph = 0;
+  for (ibloc = 0; ibloc < disk.nb_sectors; ibloc++) {
+	succ[ibloc] = pred[ibloc] = delent[ibloc] = -1;
+	if (is_orphan( ibloc)) {
+	  orph[norph].seq = seqof( ibloc);
+	  orph[norph++].blk = ibloc;
+	}
+  }
+  for (k = 0; k < nslot; k++)
+	if ((file[k].flags & 0x10) && (ibloc = ts2blk( file[k].start_trk, file[k].start_sec)) > 0
+	    && ibloc < disk.nb_sectors)
+	  delent[ibloc] = k;
+  flstat.sectors += disk.nb_sectors;
+  qsort( orph, norph, sizeof( struct Orphan), cmp_orphan);
+  rebuild_chains();
+
+// Chains start where nothing leads, with a data sector or a map
+  nchain = 0;
+  for (k = 0; k < norph; k++) {
+	ibloc = orph[k].blk;
+	if (pred[ibloc] >= 0 || (orph[k].seq == 0 && succ[ibloc] < 0))
+	  continue;
+	chain[nchain].head = ibloc;
+	chain[nchain].random = orph[k].seq == 0;
+	chain[nchain].n = chain[nchain].guessed = 0;
+	for (; ibloc >= 0; ibloc = succ[ibloc]) {
+	  chain[nchain].n++;
+	  chain[nchain].guessed += guess[ibloc];
+	}
+	ibloc = chain[nchain].head;
+	chain[nchain].seq = seqof( chain[nchain].random ? succ[succ[ibloc]] : ibloc);
+	score( &chain[nchain]);
+	if (chain[nchain].score >= minscore)
+	  nchain++;
+  }
+
+  if (!list) {
+	if (dir == NULL) {
+	  snprintf( dirname, sizeof( dirname), "%s.carved", disk.shortname);
+	  dir = dirname;
+	}
+	if (mkdir( dir, 0755) != 0) {
+	  perror( dir);
+	  exit( 3);
+	}
+  }
+
+  found = 0;
+  for (k = 0; k < nchain; k++) {
+	ibloc = chain[k].head;
+	if (chain[k].entry >= 0)
+	  sprintf( name, "_%d_%s", chain[k].entry, file[chain[k].entry].name+1);
+	else
+	  sprintf( name, "CARVE_%02X%02X.%s", blk2trk( ibloc), blk2sec( ibloc),
+		chain[k].random ? "RND" : "BIN");
+	printf( "%3d%% %-16s [%02X/%02X] %5d sectors, records %d to %d%s\n", chain[k].score, name,
+	  blk2trk( ibloc), blk2sec( ibloc), chain[k].n, chain[k].seq,
+	  chain[k].seq + chain[k].n - 1 - 2 * chain[k].random, chain[k].random ? ", random" : "");
+	if (!list && write_chain( &chain[k], dir, name) != 0)
+	  werr = 3;
+	found++;
+  }
+  stat_stop( PH_EXTRACT);
+  if (!quiet)
+	printf( "%d orphan sectors, %d file(s) found\n", norph, found);
+
+  return werr;
+}
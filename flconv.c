@@ -0,0 +1,335 @@
+/* flconv.c -- Text and S19 conversions of the Flex tools
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include <stdio.h>
+#include <string.h>
+#include "flconv.h"
+
+// The conversions work on memory buffers: the tools only read and
+// write the files, and flbench can time the conversions alone.
+
+void text_init( struct Textconv *tc, int tabstop) {
+  memset( tc, 0, sizeof( struct Textconv));
+  if (tabstop < 1)
+    tabstop = 1;
+  if (tabstop > 127)
+    tabstop = 127;
+  tc->tabstop = tabstop;
+}
+
+/////////////////////////////////////////////////////////
+// Unix text to Flex text: tabs expanded, then spaces  //
+// compressed as TAB + count, trailing spaces removed, //
+// LF replaced by CR. Spaces pending at the end of in  //
+// are kept in tc for the next buffer.                 //
+// out must hold PACK_MAX( tc, len) bytes              //
+// Return the number of bytes put in out               //
+/////////////////////////////////////////////////////////
+
+size_t pack_text( struct Textconv *tc, const uint8_t *in, size_t len, uint8_t *out) {
+  const uint8_t *end = in + len;
+  uint8_t *o = out;
+  int c, n;
+
+  while (in < end) {
+    c = *in++;
+    if (c == ' ') {
+      tc->nspace++;
+      tc->column++;
+    } else if (c == '\t') {    // TAB => prepare for multiple spaces
+      n = tc->tabstop - tc->column % tc->tabstop;
+      tc->nspace += n;
+      tc->column += n;
+    } else if (c == '\n') {
+      tc->nspace = 0;          // throw away trailing spaces
+      tc->column = 0;
+      *o++ = '\r';
+    } else {
+      if (tc->nspace) {        // time to output them, 127 at most by TAB
+        while (tc->nspace > 127) {
+          *o++ = '\t';
+          *o++ = 127;
+          tc->nspace -= 127;
+        }
+        if (tc->nspace > 2) {
+          *o++ = '\t';
+          *o++ = tc->nspace;
+        } else
+          while (tc->nspace--)
+            *o++ = ' ';
+        tc->nspace = 0;
+      }
+      *o++ = c;
+      tc->column++;
+    }
+  }
+  return o - out;
+}
+
+//////////////////////////////////////////////////////////
+// Flex text to Unix text: TAB + count expanded, CR     //
+// replaced by LF, NULs removed. out must hold          //
+// UNPACK_MAX( len) bytes. Return the bytes put in out  //
+//////////////////////////////////////////////////////////
+
+size_t unpack_text( struct Textconv *tc, const uint8_t *in, size_t len, uint8_t *out) {
+  const uint8_t *end = in + len;
+  uint8_t *o = out;
+  int c;
+
+  if (tc->count && in < end) {  // TAB was the last byte of the previous buffer
+    c = *in++;
+    memset( o, ' ', c);
+    o += c;
+    tc->count = 0;
+  }
+  while (in < end) {
+    c = *in++;
+    if (c == '\t') {
+      if (in == end) {
+        tc->count = 1;
+        break;
+      }
+      c = *in++;
+      memset( o, ' ', c);
+      o += c;
+    } else if (c == '\r')
+      *o++ = '\n';
+    else if (c != 0)           // do nothing for null in file
+      *o++ = c;
+  }
+  return o - out;
+}
+
+char *s19_errmsg[] = {  "Empty input file",
+                        "Not a Motorola S19 file",
+                        "Unexpected char or EOF",
+                        "Checksum error",
+                        "24 or 32 bits addresses not supported",
+                        "Address overflow"
+                     };
+
+// Value of n hex digits at *p, -1 if not hex or end reached
+
+static int gethex( const char **p, const char *end, int n) {
+  int out = 0, c;
+
+  while (n--) {
+    if (*p >= end)
+      return -1;
+    c = *(*p)++;
+    if (c >= '0' && c <= '9')
+      c -= '0';
+    else if (c >= 'A' && c <= 'F')
+      c -= 'A' - 10;
+    else if (c >= 'a' && c <= 'f')
+      c -= 'a' - 10;
+    else
+      return -1;
+    out = out * 16 + c;
+  }
+  return out;
+}
+
+// Write a binary record of the CMD file, keep trace of size
+
+static uint8_t *putrec( uint8_t *o, uint8_t *rec, int index, FILE *log) {
+  rec[3] = index - 4;
+  memcpy( o, rec, index);
+  if (log != NULL)
+    fprintf( log, "write %d bytes at 0x%4X\n", index, (rec[1] << 8) + rec[2]);
+  return o + index;
+}
+
+////////////////////////////////////////////////////////////
+// S19 text to a Flex .CMD binary: contiguous S1 records  //
+// are merged in binary records of 255 bytes at most, S9  //
+// gives the transfer address. The file is padded with    //
+// zeroes to fill the last sector.                        //
+// out must hold CMD_MAX( len) bytes, *line is the line   //
+// of the error if any. Details are printed on log if not //
+// NULL. Return 0 if OK, or the index + 1 of the error in //
+// s19_errmsg[]                                           //
+////////////////////////////////////////////////////////////
+
+int s19_to_cmd( const char *in, size_t len, uint8_t *out, size_t *outlen,
+                int *line, FILE *log) {
+
+  const char *p = in, *end = in + len;
+  uint8_t rec[256];                     // binary record being built
+  uint8_t *o = out;
+  int index = 0;                        // its length, 0 if none
+  int count, nAddr, checksum, c, i;
+  int address = 0;
+  char nLineType;
+
+  *line = 1;
+  *outlen = 0;
+  while (1) {
+    if (p == end) {
+      if (index == 0 && o == out)       // Empty file...
+        return 1;
+      if (index)
+        o = putrec( o, rec, index, log);
+      for (i = 252 - (o - out) % 252; i > 0; i--)
+        *o++ = 0;
+      *outlen = o - out;
+      return 0;
+    }
+    c = *p++;
+    if (c == '\r' || c == '\n') {
+      (*line)++;
+      continue;                         // skip newline
+    }
+    if (c != 'S' || p == end)           // Starting with 'S' ?
+      return 2;                         // No :-(
+
+    nLineType = *p++;
+    if ((count = gethex( &p, end, 2)) < 3)      // Always between 3 and 255
+      return 3;
+    if ((nAddr = gethex( &p, end, 4)) < 0)      // Address between 0 and 0xFFFF
+      return 3;
+    checksum = count + (nAddr >> 8) + (nAddr & 0xFF);
+    count -= 3;
+
+    switch (nLineType) {                // Examine line type
+      // Header record, ignore it except for checksum
+      // and for printing it if verbose
+      case '0' :
+        if (log != NULL)
+          fprintf( log, "Header: \"");
+        while (count--) {
+          if ((c = gethex( &p, end, 2)) < 0)
+            return 3;
+          checksum += c;
+          if (log != NULL)
+            fputc( c, log);
+        }
+        if (log != NULL)
+          fprintf( log, "\"\n");
+        break;
+      // Data record (count is always less than 255)
+      case '1' :
+        if (index && (index + count > 255 || address != nAddr)) {
+          o = putrec( o, rec, index, log);
+          index = 0;
+        }
+        if (index == 0) {
+          rec[0] = 2;
+          rec[1] = nAddr >> 8;
+          rec[2] = nAddr & 0xFF;
+          index = 4;
+          address = nAddr;
+        }
+        for (i = 0; i < count; i++) {
+          if (address++ > 0xFFFF)     // last byte may be at 0xFFFF
+            return 6;
+          if ((c = gethex( &p, end, 2)) < 0)    // retrieve a byte
+            return 3;
+          checksum += c;
+          rec[index++] = c;
+        }
+        break;
+      // 24bit and 32bit data not useful for Flex...
+      case '2' :                        // record with 24bit address
+      case '3' :                        // record with 32bit address
+      case '7' :                        // 32-bit entry point
+      case '8' :                        // 24-bit entry point
+        return 5;
+      // S5/S6 records ignored; don't think they make any sense here
+      case '5' :
+      case '6' :
+        break;
+      case '9' :
+        if (index)
+          o = putrec( o, rec, index, log);
+        index = 0;
+        *o++ = 0x16;
+        *o++ = nAddr >> 8;
+        *o++ = nAddr & 0xFF;
+        if (log != NULL)
+          fprintf( log, "Load address = 0x%4X\n", nAddr);
+        break;
+      default :                         // Type not registered
+        return 2;
+    }
+    c = gethex( &p, end, 2);            // read checksum
+    if (c < 0 || ((checksum + c) & 0xFF) ^ 0xFF)
+      return 4;
+  }
+}
+
+// Write one S record of n bytes, return its length
+
+static int puts19( char *o, char type, int addr, const uint8_t *data, int n) {
+  static const char hex[] = "0123456789ABCDEF";
+  char *start = o;
+  int checksum, i;
+
+  checksum = n + 3 + (addr >> 8) + (addr & 0xFF);
+  o += sprintf( o, "S%c%02X%04X", type, n + 3, addr);
+  for (i = 0; i < n; i++) {
+    *o++ = hex[data[i] >> 4];
+    *o++ = hex[data[i] & 0x0F];
+    checksum += data[i];
+  }
+  o += sprintf( o, "%02X\n", ~checksum & 0xFF);
+  return o - start;
+}
+
+//////////////////////////////////////////////////////////
+// Flex .CMD binary to S19 text, 16 bytes by S1 record, //
+// S9 with the transfer address (0 if none).            //
+// out must hold S19_MAX( len) bytes                    //
+// Return 0 if OK, 2 if in is not a .CMD file           //
+//////////////////////////////////////////////////////////
+
+int cmd_to_s19( const uint8_t *in, size_t len, char *out, size_t *outlen) {
+  const uint8_t *end = in + len;
+  char *o = out;
+  int addr, n, k, transfer = 0;
+
+  *outlen = 0;
+  while (in < end) {
+    switch (*in) {
+    case 0:                      // padding
+      in++;
+      break;
+    case 0x02:                   // data record: address and count
+      if (in + 4 > end || in + 4 + in[3] > end)
+        return 2;
+      addr = in[1] * 256 + in[2];
+      n = in[3];
+      in += 4;
+      for (k = 0; k < n; k += 16)
+        o += puts19( o, '1', (addr + k) & 0xFFFF, in + k, n - k < 16 ? n - k : 16);
+      in += n;
+      break;
+    case 0x16:                   // transfer address
+      if (in + 3 > end)
+        return 2;
+      transfer = in[1] * 256 + in[2];
+      in += 3;
+      break;
+    default:
+      return 2;
+    }
+  }
+  o += puts19( o, '9', transfer, NULL, 0);
+  *outlen = o - out;
+  return 0;
+}
@@ -0,0 +1,46 @@
+/* vim:ts=4
+ * flconv.h -- Text and S19 conversions of the Flex tools
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include <stdio.h>
+#include <stdint.h>
+
+// State of a text conversion, kept from one buffer to the next
+
+struct Textconv {
+    int tabstop;    // pack: tab stops interval
+    int column;     // pack: column in the current line
+    int nspace;     // pack: spaces not written yet
+    int count;      // unpack: a TAB was read, a count follows
+};
+
+// Biggest output for len bytes of input (spaces pending in tc included)
+#define PACK_MAX(tc, len) (2 * (len) + 2 * (tc)->nspace / 127 + 4)
+#define UNPACK_MAX(len) (255 * (len) + 1)
+#define CMD_MAX(len)    ((len) / 2 + 256)
+#define S19_MAX(len)    (13 * (len) + 32)
+
+extern void text_init( struct Textconv *tc, int tabstop);
+extern size_t pack_text( struct Textconv *tc, const uint8_t *in, size_t len, uint8_t *out);
+extern size_t unpack_text( struct Textconv *tc, const uint8_t *in, size_t len, uint8_t *out);
+
+// Status of s19_to_cmd(), index + 1 in s19_errmsg[]
+extern char *s19_errmsg[];
+
+extern int s19_to_cmd( const char *in, size_t len, uint8_t *out, size_t *outlen,
+                       int *line, FILE *log);
+extern int cmd_to_s19( const uint8_t *in, size_t len, char *out, size_t *outlen);
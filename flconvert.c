@@ -0,0 +1,209 @@
+/* flconvert.c -- Move a Flex disk image to another geometry
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+int verbose = 0; // more details when verbose increase
+int quiet = 1;   // by default don't give disk infos
+
+char *s_err = "",   // If color is supported => errmsg in red
+     *s_warn = "",  // warnings in yellow
+     *s_norm = "";  // return to normal
+
+void usage( char *cmd) {
+	fprintf( stderr, "Usage: %s [-h] => this help\n", cmd);
+	fprintf( stderr, "       %s [-v] [-g geometry] [-t n] [-s n] [-d] [-f n] <disk image> <new image>\n", cmd);
+    fprintf( stderr, "Options:\n");
+	fprintf( stderr, "   -g <[SS|DS][SD|DD][40|80]> => standard flex formats for 5\" floppy\n");
+	fprintf( stderr, "   -t <n> => number of tracks (2 to 256)\n");
+	fprintf( stderr, "   -s <n> => number of sectors per track (6 to 255)\n");
+	fprintf( stderr, "   -d => double density, track 0 of (sectors/2 + 2) sectors\n");
+	fprintf( stderr, "   -f <n> => number of sectors on track 0\n");
+	fprintf( stderr, "   -v => print details about the disk image\n");
+	fprintf( stderr, "   --stats[=json] => print timings and counters on stderr\n");
+	fprintf( stderr, "What is not given is kept from the disk image\n");
+}
+
+// Standard geometry [SS|DS][SD|DD][40|80] in g, -1 if not valid
+
+static int get_geometry( char *s, struct Geometry *g) {
+  int dd;
+
+  if (strlen( s) != 6 || (s[1] & 0x5F) != 'S' || (s[3] & 0x5F) != 'D' || s[5] != '0')
+	return -1;
+  if ((s[2] & 0x5F) == 'D')
+	dd = 1;
+  else if ((s[2] & 0x5F) == 'S')
+	dd = 0;
+  else
+	return -1;
+  if (s[4] == '8')
+	g->nbtrk = 80;
+  else if (s[4] == '4')
+	g->nbtrk = 40;
+  else
+	return -1;
+  if ((*s & 0x5F) == 'S')
+	g->nbsec = g->track0 = 10 * (dd+1);
+  else if ((*s & 0x5F) == 'D') {
+	g->nbsec = 18 * (dd+1);
+	g->track0 = 10 * (dd+1);
+  } else
+	return -1;
+  return 0;
+}
+
+// Program start here
+int main( int argc, char **argv)
+{
+  char *term, *getenv( const char *name);
+  static struct option longopts[] = { STATS_OPTION, { 0, 0, 0, 0 } };
+  int opt;
+  char *filepath, *newpath;
+  char *geometry = NULL;
+  struct Geometry g;
+  uint8_t *dsk;
+  int nbtrk = 0, nbsec = 0, ft = 0, dd = 0;
+  int nb, fd, retval;
+
+  while ((opt = getopt_long( argc, argv, "hvg:t:s:df:", longopts, NULL)) != -1) {
+	switch (opt) {
+	case 'h':
+	  usage( *argv);
+	  exit( 0);
+	  break;
+	case 'v':
+	  verbose = 1;
+	  quiet = 0;
+	  break;
+	case 'g':
+	  geometry = optarg;
+	  break;
+	case 't':
+	  nbtrk = atoi( optarg);
+	  break;
+	case 's':
+	  nbsec = atoi( optarg);
+	  break;
+	case 'd':
+	  dd = 1;
+	  break;
+	case 'f':
+	  ft = atoi( optarg);
+	  break;
+	case 'S':
+	  stats_init( *argv, optarg);
+	  break;
+	default: /* '?' */
+	  usage( *argv);
+	  exit( 3);
+	}
+  }
+
+  if (argc - optind != 2) {
+	usage( *argv);
+	exit( 3);
+  }
+  filepath = argv[optind];
+  newpath = argv[optind+1];
+
+// If possible, colorize Warnings and Errors
+  if (isatty( 1) && (term = getenv( "TERM")) != NULL) {
+    if (strstr( term, "256color") != NULL) {
+      s_warn = "\e[1;93m";
+      s_err  = "\e[1;91m";
+      s_norm = "\e[0m";
+    }
+  }
+
+  disk.readonly = 1;
+  if (load_image( filepath, 0))
+	exit( 3);
+  if (! isFlex( disk.dsk, disk.nb_sectors))
+	exit( 2);
+  retval = badFlex( 1);
+  if (retval > 1 && retval != 257)
+	return retval;
+  if ((retval = analyse_cached( filepath, 0)) > 1)
+	return retval;
+
+// New geometry: what is not given is kept, track 0 as flfmt does it
+  g.nbtrk = disk.nbtrk + 1;
+  g.nbsec = disk.nbsec;
+  g.track0 = disk.track0l;
+  if (geometry != NULL) {
+	if (get_geometry( geometry, &g)) {
+	  fprintf( stderr, "Geometry string '%s' not valid.\n", geometry);
+	  exit( 3);
+	}
+  } else {
+	if (nbtrk)
+	  g.nbtrk = nbtrk;
+	if (nbsec && nbsec != g.nbsec) {
+	  g.nbsec = nbsec;
+	  g.track0 = nbsec;
+	}
+	if (dd)
+	  g.track0 = g.nbsec/2 + 2;
+	if (ft)
+	  g.track0 = ft;
+  }
+  if (g.nbsec > 255 || g.nbsec < 6) {
+	fprintf( stderr, "Number of sectors : 6 to 255\n");
+	exit( 3);
+  }
+  if (g.nbtrk > 256 || g.nbtrk < 2) {
+	fprintf( stderr, "Number of tracks : 2 to 256\n");
+	exit( 3);
+  }
+  if (g.track0 < 6 || g.track0 > g.nbsec) {
+	fprintf( stderr, "Track 0 size must > 6 and less than number of sectors (%d)\n", g.nbsec);
+	exit( 3);
+  }
+
+  stat_start( PH_REMAP);
+  retval = remap_image( &g, &dsk, &nb);
+  stat_stop( PH_REMAP);
+  if (retval == 1) {
+	printf( "%sERROR: not enough room for the files on %d tracks of %d sectors%s\n",
+	  s_err, g.nbtrk, g.nbsec, s_norm);
+	exit( 1);
+  }
+  if (retval)
+	exit( retval);
+
+// Don't erase same name file
+  stat_start( PH_WRITE);
+  if ((fd = open( newpath, O_CREAT | O_WRONLY | O_EXCL, 0664)) < 0) {
+	perror( newpath);
+	exit( 3);
+  }
+  if (write( fd, dsk, nb * SECSIZE) != nb * SECSIZE) {
+	perror( newpath);
+	close( fd);
+	exit( 3);
+  }
+  close( fd);
+  flstat.wbytes += nb * SECSIZE;
+  flstat.syscalls += 3;
+  stat_stop( PH_WRITE);
+
+  if (verbose)
+	printf( "%s: %d tracks of %d sectors (%d on track 0), %d free sectors\n", newpath,
+	  g.nbtrk, g.nbsec, g.track0, dsk[0x221] * 256 + dsk[0x222]);
+  return retval;
+}
@@ -0,0 +1,200 @@
+/* flcrc.c -- Checksums of sectors, files and content of a Flex image
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+#define POLY 0x82F63B78     // CRC32C (Castagnoli), reversed
+
+static uint32_t table[8][256];
+static int hw = -1;         // CRC instruction available, -1 if not known
+
+// Tables for slicing-by-8, built at first use
+
+static void init_table( void) {
+  uint32_t crc;
+  int i, j;
+
+  for (i = 0; i < 256; i++) {
+    crc = i;
+    for (j = 0; j < 8; j++)
+      crc = crc & 1 ? (crc >> 1) ^ POLY : crc >> 1;
+    table[0][i] = crc;
+  }
+  for (i = 0; i < 256; i++)
+    for (j = 1; j < 8; j++)
+      table[j][i] = (table[j-1][i] >> 8) ^ table[0][table[j-1][i] & 0xFF];
+}
+
+// Slicing-by-8: 8 bytes per step, 8 table lookups
+
+static uint32_t crc_soft( uint32_t crc, uint8_t *buf, size_t len) {
+  uint64_t w;
+
+  for (; len >= 8; len -= 8, buf += 8) {
+    memcpy( &w, buf, 8);
+    w ^= crc;             // little endian
+    crc = table[7][w & 0xFF] ^ table[6][(w >> 8) & 0xFF]
+        ^ table[5][(w >> 16) & 0xFF] ^ table[4][(w >> 24) & 0xFF]
+        ^ table[3][(w >> 32) & 0xFF] ^ table[2][(w >> 40) & 0xFF]
+        ^ table[1][(w >> 48) & 0xFF] ^ table[0][w >> 56];
+  }
+  for (; len > 0; len--)
+    crc = (crc >> 8) ^ table[0][(crc ^ *buf++) & 0xFF];
+  return crc;
+}
+
+#if defined( __x86_64__) && defined( __GNUC__)
+// SSE 4.2 crc32 instruction, 8 bytes per instruction
+
+__attribute__(( target( "sse4.2")))
+static uint32_t crc_hw( uint32_t crc, uint8_t *buf, size_t len) {
+  uint64_t w, c = crc;
+
+  for (; len >= 8; len -= 8, buf += 8) {
+    memcpy( &w, buf, 8);
+    c = __builtin_ia32_crc32di( c, w);
+  }
+  crc = c;
+  for (; len > 0; len--)
+    crc = __builtin_ia32_crc32qi( crc, *buf++);
+  return crc;
+}
+#endif
+
+///////////////////////////////////////////////////////
+// CRC32C of buf continued from crc (0 to start),    //
+// with the CPU instruction if there is one, else by //
+// slicing-by-8                                      //
+///////////////////////////////////////////////////////
+
+uint32_t crc32c( uint32_t crc, uint8_t *buf, size_t len) {
+  if (hw < 0) {
+#if defined( __x86_64__) && defined( __GNUC__)
+    hw = __builtin_cpu_supports( "sse4.2") != 0;
+#else
+    hw = 0;
+#endif
+    if (!hw)
+      init_table();
+  }
+#if defined( __x86_64__) && defined( __GNUC__)
+  if (hw)
+    return ~crc_hw( ~crc, buf, len);
+#endif
+  return ~crc_soft( ~crc, buf, len);
+}
+
+////////////////////////////////////////////////////////
+// CRC32C of each sector of the image in crc[], which //
+// has one entry per sector. Return the CRC32C of the //
+// table (little endian), that of the whole image     //
+////////////////////////////////////////////////////////
+
+uint32_t sector_crcs( uint32_t *crc) {
+  uint8_t le[4];
+  uint32_t all = 0;
+  int ibloc;
+
+  for (ibloc = 0; ibloc < disk.nb_sectors; ibloc++) {
+    crc[ibloc] = crc32c( 0, getsec( ibloc), SECSIZE);
+    le[0] = crc[ibloc];
+    le[1] = crc[ibloc] >> 8;
+    le[2] = crc[ibloc] >> 16;
+    le[3] = crc[ibloc] >> 24;
+    all = crc32c( all, le, 4);
+  }
+  flstat.sectors += disk.nb_sectors;
+  return all;
+}
+
+///////////////////////////////////////////////////////
+// CRC32C of the payload of file k: bytes 4 to 255   //
+// of its sectors in chain order, map sectors of a   //
+// random file included. Links and record numbers    //
+// are left out, they depend on the place of the     //
+// file on the image                                 //
+///////////////////////////////////////////////////////
+
+uint32_t file_crc( int k) {
+  uint8_t *psec;
+  uint32_t crc = 0;
+  int ibloc, n;
+
+  ibloc = ts2blk( file[k].start_trk, file[k].start_sec);
+  for (n = 0; n < file[k].length && ibloc > 0; n++) {
+    psec = getsec( ibloc);
+    crc = crc32c( crc, psec + 4, SECSIZE - 4);
+    ibloc = ts2blk( psec[0], psec[1]);
+    flstat.hops++;
+  }
+  return crc;
+}
+
+static int cmp_name( const void *a, const void *b) {
+  return strcmp( (char *)file[*(int *)a].name, (char *)file[*(int *)b].name);
+}
+
+//////////////////////////////////////////////////////////
+// Hash of the logical content of the analysed image:   //
+// for each valid file, in name order, its name, date,  //
+// protection, random flag, length and the data of its  //
+// sectors, the map of a random file apart (it only     //
+// tells where the sectors are). Free sectors, deleted  //
+// entries, directory order and the place of the files  //
+// are left out: images with the same files have the    //
+// same hash, whatever their geometry or their history  //
+//////////////////////////////////////////////////////////
+
+uint64_t logical_hash( void) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  uint8_t head[32], *psec;
+  int *order, nb = 0;
+  int i, k, n, len, ibloc;
+
+  if ((order = malloc( (nslot + 1) * sizeof( int))) == NULL)
+    return 0;
+  for (k = 0; k < nslot; k++)
+    if ((file[k].flags & 0x11) == 1)
+      order[nb++] = k;
+  qsort( order, nb, sizeof( int), cmp_name);
+
+  for (i = 0; i < nb; i++) {
+    k = order[i];
+    len = strlen( (char *)file[k].name) + 1;
+    memcpy( head, file[k].name, len);
+    head[len++] = file[k].year >> 8;
+    head[len++] = file[k].year;
+    head[len++] = file[k].month;
+    head[len++] = file[k].day;
+    head[len++] = file[k].pos[0x0B];   // protection
+    head[len++] = file[k].flags & 2;
+    head[len++] = file[k].length >> 8;
+    head[len++] = file[k].length;
+    h = mix64( h ^ hash64( head, len));
+
+    ibloc = ts2blk( file[k].start_trk, file[k].start_sec);
+    for (n = 0; n < file[k].length && ibloc > 0; n++) {
+      psec = getsec( ibloc);
+      if (n >= 2 || (file[k].flags & 2) == 0)
+        h = mix64( h ^ hash64( psec + 4, SECSIZE - 4));
+      ibloc = ts2blk( psec[0], psec[1]);
+      flstat.hops++;
+    }
+  }
+  free( order);
+  return h;
+}
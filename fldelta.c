@@ -0,0 +1,226 @@
+/* fldelta.c -- Sector patches between two Flex images, for fldiff and flpatch
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+// Patch file: a header, then for each run of sectors changed
+// its first sector, its length, the CRC32C of its sectors before
+// and after, and the new sectors. Numbers are little endian.
+//   0  "FLPATCH1"
+//   8  number of sectors of the image
+//  12  highest track, sectors per track, sectors on track 0 (2 bytes)
+//  16  CRC of the base image (as flsum gives it)
+//  20  CRC of the new image
+// flpatch reads the runs only: the CRC of the images is not checked,
+// those of the runs are.
+//  24  number of runs
+//  28  0
+
+#define PATCH_MAGIC "FLPATCH1"
+#define HEADSIZE 32
+#define RUNSIZE 16
+
+static void put32( uint8_t *p, uint32_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static uint32_t get32( uint8_t *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/////////////////////////////////////////////////////////
+// Compare the image in memory with base, an image of  //
+// the same size: changed[] gets 1 for each sector     //
+// that differs (memcmp() compares a word or a vector  //
+// at a time). Return the number of sectors changed    //
+/////////////////////////////////////////////////////////
+
+int diff_sectors( uint8_t *base, uint8_t *changed) {
+  int ibloc, n = 0;
+
+  for (ibloc = 0; ibloc < disk.nb_sectors; ibloc++) {
+    changed[ibloc] = memcmp( base + ibloc * SECSIZE, disk.dsk + ibloc * SECSIZE, SECSIZE) != 0;
+    n += changed[ibloc];
+  }
+  flstat.sectors += 2 * disk.nb_sectors;
+  return n;
+}
+
+// Write len bytes on fd, return 3 if it fails
+
+static int put_bytes( int fd, uint8_t *buf, size_t len) {
+  flstat.syscalls++;
+  if (write( fd, buf, len) != len) {
+    perror( "patch");
+    return 3;
+  }
+  flstat.wbytes += len;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////
+// Write on fd the patch from base to the image in memory //
+// with the runs of changed[] sectors. oldcrc and newcrc  //
+// are the CRC of the two images.                         //
+// Return 0 if OK, 3 if the patch can't be written        //
+////////////////////////////////////////////////////////////
+
+int write_patch( int fd, uint8_t *base, uint8_t *changed, uint32_t oldcrc, uint32_t newcrc) {
+  uint8_t head[HEADSIZE];
+  int first, last, nrun = 0;
+
+  for (first = 0; first < disk.nb_sectors; first++)
+    if (changed[first] && (first == 0 || !changed[first - 1]))
+      nrun++;
+  memset( head, 0, HEADSIZE);
+  memcpy( head, PATCH_MAGIC, 8);
+  put32( head + 8, disk.nb_sectors);
+  head[12] = disk.dsk[0x226];
+  head[13] = disk.dsk[0x227];
+  head[14] = disk.track0l;
+  head[15] = disk.track0l >> 8;
+  put32( head + 16, oldcrc);
+  put32( head + 20, newcrc);
+  put32( head + 24, nrun);
+  if (put_bytes( fd, head, HEADSIZE))
+    return 3;
+
+  for (first = 0; first < disk.nb_sectors; first = last) {
+    while (first < disk.nb_sectors && !changed[first])
+      first++;
+    for (last = first; last < disk.nb_sectors && changed[last]; last++)
+      ;
+    if (last == first)
+      break;
+    put32( head, first);
+    put32( head + 4, last - first);
+    put32( head + 8, crc32c( 0, base + first * SECSIZE, (last - first) * SECSIZE));
+    put32( head + 12, crc32c( 0, disk.dsk + first * SECSIZE, (last - first) * SECSIZE));
+    if (put_bytes( fd, head, RUNSIZE)
+        || put_bytes( fd, disk.dsk + first * SECSIZE, (last - first) * SECSIZE))
+      return 3;
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////
+// Read the patch at path and verify it is one for the   //
+// loaded image (same size and geometry), and that the   //
+// sectors of each run have the CRC recorded for them.   //
+// *buf gets the whole patch, *size its size.            //
+// Return 0 if OK, 1 if the geometry is not the same, 2  //
+// if it is not a valid patch, 3 if it can't be read     //
+///////////////////////////////////////////////////////////
+
+int read_patch( char *path, uint8_t **buf, long *size) {
+  struct stat st;
+  uint8_t *p, *end;
+  uint32_t n, nrun;
+  int fd;
+
+  flstat.syscalls += 4;     // open, fstat, read and close
+  if ((fd = open( path, O_RDONLY)) < 0 || fstat( fd, &st) < 0) {
+    perror( path);
+    return 3;
+  }
+  if ((*buf = malloc( st.st_size + 1)) == NULL
+      || read( fd, *buf, st.st_size) != st.st_size) {
+    perror( path);
+    close( fd);
+    return 3;
+  }
+  close( fd);
+  flstat.rbytes += st.st_size;
+  *size = st.st_size;
+  p = *buf;
+  end = p + st.st_size;
+
+  if (st.st_size < HEADSIZE || memcmp( p, PATCH_MAGIC, 8) != 0) {
+    fprintf( stderr, "%s: not a Flex image patch\n", path);
+    return 2;
+  }
+  if (get32( p + 8) != disk.nb_sectors || p[12] != disk.dsk[0x226] || p[13] != disk.dsk[0x227]) {
+    printf( "%sERROR: patch for an image of %d sectors, %d tracks of %d sectors%s\n",
+      s_err, get32( p + 8), p[12] + 1, p[13], s_norm);
+    return 1;
+  }
+  nrun = get32( p + 24);
+  for (p += HEADSIZE; nrun > 0 && end - p >= RUNSIZE; nrun--) {
+    n = get32( p + 4);
+    if (get32( p) + (uint64_t)n > disk.nb_sectors || n == 0
+        || end - p - RUNSIZE < (uint64_t)n * SECSIZE
+        || crc32c( 0, p + RUNSIZE, n * SECSIZE) != get32( p + 12))
+      break;
+    p += RUNSIZE + n * SECSIZE;
+  }
+  if (nrun != 0 || p != end) {
+    fprintf( stderr, "%s: patch truncated or corrupted\n", path);
+    return 2;
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////
+// Apply the patch in patch (verified by read_patch()) to //
+// the image filepath, loaded in memory, maybe partially. //
+// Only the sectors of the runs are read, their CRC must  //
+// be the one of the base image for all the runs (or of   //
+// the new image for all: the patch was already applied). //
+// Then the runs are written in place.                    //
+// Return 0 if OK, -1 if already applied, 1 if the image  //
+// is not the base of the patch, 3 if it can't be written //
+////////////////////////////////////////////////////////////
+
+int apply_patch( uint8_t *patch, char *filepath) {
+  uint8_t *p;
+  uint32_t first, n, crc;
+  int nrun, k, old = 0, new = 0;
+
+  nrun = get32( patch + 24);
+  for (k = 0, p = patch + HEADSIZE; k < nrun; k++, p += RUNSIZE + n * SECSIZE) {
+    first = get32( p);
+    n = get32( p + 4);
+    if (disk.loaded != NULL && read_sectors( first, n))
+      return 3;
+    crc = crc32c( 0, disk.dsk + first * SECSIZE, n * SECSIZE);
+    if (crc == get32( p + 8))
+      old++;
+    else if (crc == get32( p + 12))
+      new++;
+    else if (verbose)
+      printf( "%sSectors [%02X/%02X] to [%02X/%02X] are not those of the base image%s\n",
+        s_warn, blk2trk( first), blk2sec( first), blk2trk( first + n - 1),
+        blk2sec( first + n - 1), s_norm);
+    flstat.sectors += n;
+  }
+  if (new == nrun && nrun > 0)
+    return -1;
+  if (old != nrun)
+    return 1;
+
+  for (k = 0, p = patch + HEADSIZE; k < nrun; k++, p += RUNSIZE + n * SECSIZE) {
+    first = get32( p);
+    n = get32( p + 4);
+    memcpy( disk.dsk + first * SECSIZE, p + RUNSIZE, n * SECSIZE);
+    if (write_sectors( filepath, first, n))
+      return 3;
+  }
+  return 0;
+}
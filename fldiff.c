@@ -0,0 +1,270 @@
+/* fldiff.c -- Sectors and files changed between two Flex disk images
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+int verbose = 0; // more details when verbose increase
+int quiet = 1;   // by default don't give disk infos
+
+char *s_err = "",   // If color is supported => errmsg in red
+     *s_warn = "",  // warnings in yellow
+     *s_norm = "";  // return to normal
+
+// What the base image had, once it is released
+
+static uint8_t *base;        // its sectors
+static int *owner;           // its tabsec[]
+static char (*name)[16];     // names of its files, "" if not valid
+static int nbase;            // its number of slots
+static int nbsect;           // its number of sectors
+static char **sorted;        // names of its valid files, sorted
+static int nsorted;
+
+void usage( char *cmd) {
+	fprintf( stderr, "Usage: %s [-h] => this help\n", cmd);
+	fprintf( stderr, "       %s [-q|-v] [-o patch] <base image> <new image>\n", cmd);
+    fprintf( stderr, "Options:\n");
+	fprintf( stderr, "   -o <patch> => write the patch from base to new image ('-' = stdout)\n");
+	fprintf( stderr, "   -q => quiet, only the return value\n");
+	fprintf( stderr, "   -v => print details about the images and the sectors changed\n");
+	fprintf( stderr, "   --stats[=json] => print timings and counters on stderr\n");
+}
+
+static int cmp_name( const void *a, const void *b) {
+  return strcmp( *(char **)a, *(char **)b);
+}
+
+////////////////////////////////////////////////////////
+// Load and analyse an image.                         //
+// Return 0 if OK, 2 if it is not a Flex image or is  //
+// damaged, 3 if it can't be read                     //
+////////////////////////////////////////////////////////
+
+static int open_image( char *filepath) {
+  int retval;
+
+  if (load_image( filepath, 0))
+    return 3;
+  if (! isFlex( disk.dsk, disk.nb_sectors))
+    return 2;
+  retval = badFlex( 1);
+  if (retval > 1 && retval != 257)
+    return retval;
+  if ((retval = analyse_cached( filepath, 0)) > 1)
+    return retval;
+  return 0;
+}
+
+////////////////////////////////////////////////////////
+// Keep what is needed of the base image: its sectors //
+// (taken over from the library), the owner of each   //
+// of them and the names of its files, then release   //
+// it so that the new image can be loaded             //
+////////////////////////////////////////////////////////
+
+static void keep_base( void) {
+  int k;
+
+  base = disk.dsk;
+  disk.dsk = NULL;
+  owner = tabsec;
+  tabsec = NULL;
+  nbase = nslot;
+  nbsect = disk.nb_sectors;
+  name = calloc( nslot + 1, 16);
+  sorted = malloc( (nslot + 1) * sizeof( char *));
+  nsorted = 0;
+  for (k = 0; k < nslot; k++)
+    if ((file[k].flags & 0x11) == 1) {
+      strcpy( name[k], (char *)file[k].name);
+      sorted[nsorted++] = name[k];
+    }
+  qsort( sorted, nsorted, sizeof( char *), cmp_name);
+  close_image();
+}
+
+// What uses bloc ibloc in the new image and in the base
+
+static void print_sector( int ibloc) {
+  char *what[2];
+  int i, own;
+
+  for (i = 0; i < 2; i++) {
+    own = i ? owner[ibloc] : tabsec[ibloc];
+    if (ibloc < 3)
+      what[i] = ibloc < 2 ? "boot" : "SIR";
+    else if (own > 0)
+      what[i] = i ? name[own - 1] : (char *)file[own - 1].name;
+    else if (own == 0)
+      what[i] = "directory";
+    else if (own == -1)
+      what[i] = "free";
+    else
+      what[i] = "unused";
+  }
+  if (strcmp( what[0], what[1]) == 0)
+    printf( "[%02X/%02X] %s\n", blk2trk( ibloc), blk2sec( ibloc), what[0]);
+  else
+    printf( "[%02X/%02X] %s -> %s\n", blk2trk( ibloc), blk2sec( ibloc), what[1], what[0]);
+}
+
+//////////////////////////////////////////////////////////
+// Files of the new image that are not in the base are  //
+// new, files of the base no more in the new image were //
+// removed (only their directory entry changed), the    //
+// others are changed if they use a sector that changed //
+// in one of the images                                 //
+//////////////////////////////////////////////////////////
+
+static void print_files( uint8_t *changed) {
+  uint8_t *tnew, *tbase;
+  char *key;
+  int ibloc, k;
+
+  tnew = calloc( nslot + 1, 1);
+  tbase = calloc( nbase + 1, 1);
+  for (ibloc = 0; ibloc < disk.nb_sectors; ibloc++)
+    if (changed[ibloc]) {
+      if (tabsec[ibloc] > 0)
+        tnew[tabsec[ibloc] - 1] = 1;
+      if (owner[ibloc] > 0)
+        tbase[owner[ibloc] - 1] = 1;
+    }
+  for (k = 0; k < nslot; k++)
+    if ((file[k].flags & 0x11) == 1) {
+      key = (char *)file[k].name;
+      if (bsearch( &key, sorted, nsorted, sizeof( char *), cmp_name) == NULL)
+        printf( "%s: new\n", key);
+      else if (tnew[k])
+        printf( "%s: changed\n", key);
+    }
+  for (k = 0; k < nbase; k++)
+    if (name[k][0]) {
+      if ((ibloc = find_file( name[k])) < 0)
+        printf( "%s: removed\n", name[k]);
+      else if (tbase[k] && !tnew[ibloc])    // moved to sectors that were free
+        printf( "%s: changed\n", name[k]);
+    }
+  free( tnew);
+  free( tbase);
+}
+
+// Program start here
+int main( int argc, char **argv)
+{
+  char *term, *getenv( const char *name);
+  static struct option longopts[] = { STATS_OPTION, { 0, 0, 0, 0 } };
+  int opt;
+  char *patch = NULL;
+  uint8_t *changed;
+  uint32_t oldcrc, newcrc, *crc;
+  int silent = 0;
+  int retval, nchg, ibloc, fd;
+
+  while ((opt = getopt_long( argc, argv, "hqvo:", longopts, NULL)) != -1) {
+	switch (opt) {
+	case 'h':
+	  usage( *argv);
+	  exit( 0);
+	  break;
+	case 'q':
+	  silent = 1;
+	  break;
+	case 'v':
+	  verbose = 1;
+	  break;
+	case 'o':
+	  patch = optarg;
+	  break;
+	case 'S':
+	  stats_init( *argv, optarg);
+	  break;
+	default: /* '?' */
+	  usage( *argv);
+	  exit( 3);
+	}
+  }
+
+  if (argc - optind != 2) {
+	usage( *argv);
+	exit( 3);
+  }
+
+// The patch may go to stdout, the messages then go to stderr
+  fd = -1;
+  if (patch != NULL && strcmp( patch, "-") == 0) {
+	if (isatty( 1)) {
+	  fprintf( stderr, "The patch can't be written on a terminal\n");
+	  exit( 3);
+	}
+	fd = dup( 1);
+	dup2( 2, 1);
+  }
+
+// If possible, colorize Warnings and Errors
+  if (isatty( 1) && (term = getenv( "TERM")) != NULL) {
+    if (strstr( term, "256color") != NULL) {
+      s_warn = "\e[1;93m";
+      s_err  = "\e[1;91m";
+      s_norm = "\e[0m";
+    }
+  }
+
+  disk.readonly = 1;
+  if ((retval = open_image( argv[optind])) != 0)
+	return retval;
+  crc = malloc( disk.nb_sectors * sizeof( uint32_t));
+  oldcrc = sector_crcs( crc);
+  keep_base();
+  if ((retval = open_image( argv[optind+1])) != 0)
+	return retval;
+  if (disk.nb_sectors != nbsect || memcmp( disk.dsk + 0x226, base + 0x226, 2) != 0) {
+	printf( "%sERROR: images of different geometries, use flconvert first%s\n", s_err, s_norm);
+	exit( 2);
+  }
+  newcrc = sector_crcs( crc);
+  free( crc);
+
+  stat_start( PH_SUM);
+  changed = calloc( disk.nb_sectors, 1);
+  nchg = diff_sectors( base, changed);
+  stat_stop( PH_SUM);
+
+  if (!silent) {
+	if (verbose)
+	  for (ibloc = 0; ibloc < disk.nb_sectors; ibloc++)
+		if (changed[ibloc])
+		  print_sector( ibloc);
+	print_files( changed);
+	if (verbose)
+	  printf( "%d sectors changed\n", nchg);
+  }
+
+  if (patch != NULL) {
+	stat_start( PH_WRITE);
+	if (fd < 0 && (fd = open( patch, O_WRONLY | O_CREAT | O_EXCL, 0644)) < 0) {
+	  perror( patch);
+	  exit( 3);
+	}
+	flstat.syscalls += 2;
+	if (write_patch( fd, base, changed, oldcrc, newcrc))
+	  exit( 3);
+	close( fd);
+	stat_stop( PH_WRITE);
+  }
+  return nchg != 0;
+}
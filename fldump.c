@@ -25,34 +25,33 @@ int verbose = 0;
 int quiet = 0;
 int all = 0;
 int where = 0;
+int tfd = -1;      // tar stream, if any
 
 void usage( char *cmd) {
 	fprintf( stderr, "Usage: %s [-h] => this help\n", cmd);
-	fprintf( stderr, "       %s [-q|-v] [-b] [-a] <file>\n", cmd);
+	fprintf( stderr, "       %s [-q|-v] [-b] [-a] [--tar=<archive>|-] <file>\n", cmd);
     fprintf( stderr, "Options:\n");
 	fprintf( stderr, "   -a => extract deleted files if possible\n");
 	fprintf( stderr, "   -b => directory for extracted files based on file name\n");
 	fprintf( stderr, "   -q => quiet, don't print anything except error messages\n");
 	fprintf( stderr, "   -v => print a detailled listing of files\n");
+	fprintf( stderr, "   --tar=<archive> => write a tar archive instead, '-' for stdout\n");
+	fprintf( stderr, "   --stats[=json] => print timings and counters on stderr\n");
 }
 
-// Download file (text not converted, raw binary, random file tagged)
+// Download file (text not converted, raw binary, random file tagged),
+// or add it to the tar stream
+// Return as write_file(), 4 if it can't be written
 
-void download( int index, char *dir) {
-  uint8_t *current, *next, cftrk, cfsec;
-  FILE *out;
-  int nb_blk, j;
+int download( int index, char *dir) {
   char path[32];
   char filename[20];
-  struct utimbuf new_times;
-  struct tm dsktime;
-  time_t itime;
 
   if (file[index].name[0] == '?' )
 	if ((file[index].flags & 0x20) == 0 || all == 0)
-	  return;
-  if ((file[index].flags & 0x80) != 0)
-	return;
+	  return 0;
+  if ((file[index].flags & 0x01) == 0 || (file[index].flags & 0x80) != 0)
+	return 0;
 
   strcpy( path, dir);
   strcat( path, "/");
@@ -61,63 +60,29 @@ void download( int index, char *dir) {
 	strcat( path, filename);
   } else
 	strcat( path, file[index].name);
-// Flag b added for DOS/Window systems
-  if ((out = fopen( path, "wb")) == NULL)
-	perror( path);
-  cftrk = file[index].start_trk;
-  cfsec = file[index].start_sec;
-  current = ts2pos( cftrk, cfsec);
-  if (file[index].flags & 0x02) {
-	fputs( "#FLEX##RAND#", out);
-	j = 16;
-  } else
-	j = 4;
-
-  nb_blk = 0;
-  while (nb_blk < file[index].length) {
-	if (ts2blk( cftrk, cfsec) < 1) {
-	  break;
-	}
-	current = ts2pos( cftrk, cfsec);
-	nb_blk++;
-	cftrk = current[0];
-	cfsec = current[1];
-	while (j < 256)
-		fputc( current[j++], out);
-	j = 4;
-  }
-  fclose( out);
-  dsktime.tm_hour = 12;
-  dsktime.tm_min = 0;
-  dsktime.tm_sec = 0;
-  dsktime.tm_isdst = 0;
-  dsktime.tm_mday = file[index].day;
-  dsktime.tm_mon = file[index].month-1;
-  dsktime.tm_year = file[index].year-1900;  // Why -1900 ???
-  itime = mktime( &dsktime);
-
-  new_times.actime = time( NULL);
-  new_times.modtime = itime;
-  utime( path, &new_times);
-
-  if (cftrk != 0 || cfsec != 0 || nb_blk != file[index].length)
-	printf( "Warning! file '%s' may be truncated...\n", path);
+  if (tfd >= 0)
+	return tar_file( tfd, index, path);
+  else
+	return write_file( index, path, 0, 1);
 }
 
 // Program starts here
 
 int main( int argc, char **argv)
 {
+  static struct option longopts[] = { STATS_OPTION,
+	{ "tar", required_argument, 0, 'T' },
+	{ 0, 0, 0, 0 } };
   int opt;
   char *filepath;
   int retval = 0;
-  struct stat dsk_stat;
   int flags;
   int k;
   char dirname[32];
+  char *tarfile = NULL;
   char *term, *getenv( const char *name);
 
-  while ((opt = getopt( argc, argv, "abhqv")) != -1) {
+  while ((opt = getopt_long( argc, argv, "abhqv", longopts, NULL)) != -1) {
 	switch (opt) {
 	case 'h':
 	  usage( *argv);
@@ -135,12 +100,28 @@ int main( int argc, char **argv)
 	case 'q':
 	  quiet = 1;
 	  break;
+	case 'T':
+	  tarfile = optarg;
+	  break;
+	case 'S':
+	  stats_init( *argv, optarg);
+	  break;
 	default: /* '?' */
 	  usage( *argv);
 	  exit( 3);
 	}
   }
 
+// The archive on stdout, messages go to stderr
+  if (tarfile != NULL && strcmp( tarfile, "-") == 0) {
+	if (isatty( 1)) {
+	  fprintf( stderr, "Refusing to write a tar archive on a terminal\n");
+	  exit( 3);
+	}
+	tfd = dup( 1);
+	dup2( 2, 1);
+  }
+
 // If possible, colorize Warnings and Errors
   if (isatty( 1) && (term = getenv( "TERM")) != NULL) {
     if (strstr( term, "256color") != NULL) {
@@ -172,30 +153,9 @@ int main( int argc, char **argv)
 	exit( 3);
   }
 
-// More checking on file
-  if (stat( filepath, &dsk_stat)) {
-	perror( filepath); 
-	exit( 3);
-  }
-
-  disk.shortname = strrchr( filepath, '/');
-  if (disk.shortname == NULL)
-	disk.shortname = filepath;
-  else
-	disk.shortname++;
-
   disk.readonly = 1;
-  disk.fd = open( filepath, O_RDONLY);
-  disk.size = dsk_stat.st_size;
-  if ((disk.dsk = malloc( disk.size)) == NULL) {
-	perror( "Malloc failed: ");
-	exit( 3);
-  }
-  if (read( disk.fd, disk.dsk, disk.size) < 0) {
-    perror( filepath);
+  if (load_image( filepath, 0))
 	exit( 3);
-  }
-  close( disk.fd);
 
   // Is it a clean flex image ?
 
@@ -206,7 +166,7 @@ int main( int argc, char **argv)
   if (retval > 1 && retval != 257)
 	return retval;
 
-  if ((retval = analyse( 0)) > 1)
+  if ((retval = analyse_cached( filepath, 0)) > 1)
 	return retval;
 
 // Print file list...
@@ -219,15 +179,27 @@ int main( int argc, char **argv)
   else
 	sprintf( dirname, "%s.dir", disk.shortname);
 
-  if (mkdir( dirname, 0755) != 0) {
+  if (tarfile != NULL) {
+	if (tfd < 0 && (tfd = open( tarfile, O_WRONLY | O_CREAT | O_EXCL, 0644)) < 0) {
+	  perror( tarfile);
+	  exit( 3);
+	}
+  } else if (mkdir( dirname, 0755) != 0) {
 	perror( dirname);
 	exit( 3);
   }
 
-// copy all files in the directory created
-  for (k = 0; k < nfile; k++) {
-	download( k, dirname);
-  }
+// copy all files in the directory created, or in the archive,
+// up to the first one that can't be written
+  stat_start( PH_EXTRACT);
+  for (k = 0; k < nslot; k++)
+	if (download( k, dirname) > 1) {
+	  retval = 3;
+	  break;
+	}
+  if (tfd >= 0 && k == nslot && tar_end( tfd))
+	retval = 3;
+  stat_stop( PH_EXTRACT);
 
   return retval;
 }
@@ -0,0 +1,245 @@
+/* flextract.c -- Write files of the image out, for fldump and flread
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include <sys/uio.h>
+#include "dskflex.h"
+#include "flconv.h"
+
+#define OUTBUF (256 * 1024)   // output written by chunks of this size
+#define NIOV 256              // sectors given to one writev()
+#define TARBLK 512            // tar block
+#define TARREC (20 * TARBLK)  // tar record, the archive is padded to it
+
+static uint8_t zero[TARBLK];
+static long tarsize = 0;      // bytes of the tar stream written
+
+// Date of file k on the image, at noon
+
+static time_t file_time( int k) {
+  struct tm dsktime;
+
+  dsktime.tm_hour = 12;
+  dsktime.tm_min = 0;
+  dsktime.tm_sec = 0;
+  dsktime.tm_isdst = 0;
+  dsktime.tm_mday = file[k].day;
+  dsktime.tm_mon = file[k].month-1;
+  dsktime.tm_year = file[k].year-1900;  // Why -1900 ???
+  return mktime( &dsktime);
+}
+
+/////////////////////////////////////////////////////////
+// Write file k of the image in path: raw sectors, a   //
+// random file starts with "#FLEX##RAND#" followed by  //
+// its map, text is converted to Unix if convert. The  //
+// sectors are gathered in a buffer written by large   //
+// chunks, the file is dated as on the image           //
+// Return 0 if OK, 1 if the file may be truncated, 3   //
+// if path exists and not replace, 4 if it can't be    //
+// written                                             //
+/////////////////////////////////////////////////////////
+
+int write_file( int k, char *path, int convert, int replace) {
+  struct stat file_stat;
+  struct Textconv tc;
+  struct utimbuf new_times;
+  uint8_t *buf, *o, *psec;
+  int fd, ibloc, nb_blk, j;
+  int retval = 0;
+
+  if (replace == 0 && stat( path, &file_stat) == 0)
+    return 3;
+  if ((fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+    perror( path);
+    return 4;
+  }
+  if ((buf = malloc( OUTBUF)) == NULL) {
+    perror( "malloc: ");
+    close( fd);
+    return 4;
+  }
+  text_init( &tc, 8);
+  o = buf;
+
+  if (file[k].flags & 0x02) {
+    memcpy( o, "#FLEX##RAND#", 12);
+    o += 12;
+    j = 16;
+  } else
+    j = 4;
+
+  ibloc = ts2blk( file[k].start_trk, file[k].start_sec);
+  for (nb_blk = 0; nb_blk < file[k].length && ibloc > 0; nb_blk++) {
+    psec = getsec( ibloc);
+    if (convert)
+      o += unpack_text( &tc, psec + j, SECSIZE - j, o);
+    else {
+      memcpy( o, psec + j, SECSIZE - j);
+      o += SECSIZE - j;
+    }
+    j = 4;
+    ibloc = ts2blk( psec[0], psec[1]);
+    flstat.hops++;
+    if (o - buf > OUTBUF - UNPACK_MAX( SECSIZE) || nb_blk == file[k].length - 1) {
+      if (write( fd, buf, o - buf) != o - buf) {
+        perror( path);
+        retval = 4;
+        break;
+      }
+      flstat.wbytes += o - buf;
+      flstat.syscalls++;
+      o = buf;
+    }
+  }
+  if (o > buf && retval == 0) {    // chain shorter than the file
+    if (write( fd, buf, o - buf) != o - buf) {
+      perror( path);
+      retval = 4;
+    }
+    flstat.wbytes += o - buf;
+    flstat.syscalls++;
+  }
+  free( buf);
+  close( fd);
+  flstat.syscalls += 3;     // open, close and utime
+
+  new_times.actime = time( NULL);
+  new_times.modtime = file_time( k);
+  utime( path, &new_times);
+
+  if (retval == 0 && (ibloc != 0 || nb_blk != file[k].length)) {
+    printf( "Warning! file '%s' may be truncated...\n", path);
+    retval = 1;
+  }
+  return retval;
+}
+
+// Give n iovecs to writev(), return 0 if OK, 4 on error
+
+static int flush_iov( int fd, struct iovec *iov, int n) {
+  ssize_t len = 0;
+  int i;
+
+  for (i = 0; i < n; i++)
+    len += iov[i].iov_len;
+  if (n && writev( fd, iov, n) != len) {
+    perror( "tar");
+    return 4;
+  }
+  flstat.wbytes += len;
+  flstat.syscalls++;
+  tarsize += len;
+  return 0;
+}
+
+// ustar header of a regular file in h (TARBLK bytes)
+
+static void tar_header( uint8_t *h, char *name, long size, time_t mtime) {
+  int sum, i;
+
+  memset( h, 0, TARBLK);
+  strncpy( (char *)h, name, 100);
+  strcpy( (char *)h + 100, "0000644");
+  strcpy( (char *)h + 108, "0000000");
+  strcpy( (char *)h + 116, "0000000");
+  sprintf( (char *)h + 124, "%011lo", size);
+  sprintf( (char *)h + 136, "%011lo", (long)mtime);
+  memset( h + 148, ' ', 8);     // checksum computed with blanks here
+  h[156] = '0';
+  memcpy( h + 257, "ustar\0" "00", 8);
+  strcpy( (char *)h + 265, "flex");
+  strcpy( (char *)h + 297, "flex");
+  for (sum = i = 0; i < TARBLK; i++)
+    sum += h[i];
+  sprintf( (char *)h + 148, "%06o", sum);   // followed by NUL and blank
+}
+
+/////////////////////////////////////////////////////////
+// Append file k of the image to the tar stream fd as  //
+// name, with the same content as write_file() without //
+// conversion. The sectors are given to writev()       //
+// straight from the image, no copy is made.           //
+// Return 0 if OK, 1 if the file may be truncated, 4   //
+// on a write error                                    //
+/////////////////////////////////////////////////////////
+
+int tar_file( int fd, int k, char *name) {
+  static char magic[] = "#FLEX##RAND#";
+  struct iovec iov[NIOV];
+  uint8_t header[TARBLK];
+  uint8_t *psec;
+  int ibloc, nb_blk, n, j;
+  long size;
+
+// First pass on the chain for the size, the header comes first
+  ibloc = ts2blk( file[k].start_trk, file[k].start_sec);
+  for (nb_blk = 0; nb_blk < file[k].length && ibloc > 0; nb_blk++) {
+    psec = getsec( ibloc);
+    ibloc = ts2blk( psec[0], psec[1]);
+  }
+  size = (long)nb_blk * (SECSIZE - 4);
+  tar_header( header, name, size, file_time( k));
+  iov[0].iov_base = header;
+  iov[0].iov_len = TARBLK;
+  n = 1;
+
+  j = 4;
+  if (file[k].flags & 0x02 && nb_blk) {
+    iov[n].iov_base = magic;
+    iov[n++].iov_len = 12;
+    j = 16;
+  }
+  ibloc = ts2blk( file[k].start_trk, file[k].start_sec);
+  for (nb_blk = 0; nb_blk < file[k].length && ibloc > 0; nb_blk++) {
+    psec = getsec( ibloc);
+    iov[n].iov_base = psec + j;
+    iov[n++].iov_len = SECSIZE - j;
+    j = 4;
+    ibloc = ts2blk( psec[0], psec[1]);
+    flstat.hops++;
+    if (n == NIOV) {
+      if (flush_iov( fd, iov, n))
+        return 4;
+      n = 0;
+    }
+  }
+  if (size % TARBLK) {
+    iov[n].iov_base = zero;
+    iov[n++].iov_len = TARBLK - size % TARBLK;
+  }
+  if (flush_iov( fd, iov, n))
+    return 4;
+
+  if (ibloc != 0 || nb_blk != file[k].length) {
+    printf( "Warning! file '%s' may be truncated...\n", name);
+    return 1;
+  }
+  return 0;
+}
+
+// End of the tar stream: two zero blocks, then padding to a full record
+
+int tar_end( int fd) {
+  struct iovec iov[TARREC / TARBLK + 1];
+  int n = 0;
+
+  do {
+    iov[n].iov_base = zero;
+    iov[n++].iov_len = TARBLK;
+  } while (n < 2 || (tarsize + n * TARBLK) % TARREC);
+  return flush_iov( fd, iov, n);
+}
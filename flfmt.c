@@ -26,6 +26,7 @@
 #include <errno.h>
 #include <time.h>
 #include <ctype.h>
+#include "flstats.h"
 
 #define VERSION "1.2 (2024-08-01)"
 
@@ -44,6 +45,7 @@ void usage( char *cmd) {
 	printf( "  -g --geometry=[SS|DS][SD|DD][40|80] (standard flex formats for 5\" floppy)\n");
 	printf( "     example : DSSD80 for a double side single density 80 track floppy\n");
 	printf( "     if this option is used, options -t, -s, -f and -d are ignored\n");
+	printf( "  --stats[=json] : print timings and counters on stderr\n");
 	printf( "If no extension is given, '.dsk' is used.\n");
 	printf( "Flex volume name is limited to the 11 first chars of the -l parameter, or\n");
 	printf( "if -l not present, the first 11 chars of the filename, without extension.\n");
@@ -87,6 +89,7 @@ int main(int argc, char *argv[])
 		{"first-track",		required_argument,	0, 'f' },
 		{"double-density",	no_argument,		0, 'd' },
 		{"geometry",		required_argument,	0, 'g' },
+		STATS_OPTION,
 		{0,					0,					0, 0 }
 	} ;
 	int opt, val;
@@ -140,6 +143,10 @@ int main(int argc, char *argv[])
 			}
 		    break;
 
+		case 'S':
+			stats_init( *argv, optarg);
+			break;
+
 		case 'h':
 		case '?':
 			usage( *argv);
@@ -254,6 +261,8 @@ int main(int argc, char *argv[])
 		exit( EXIT_FAILURE);
 	}
 
+	stat_start( PH_FORMAT);
+
 	// print what we are doing
 	printf( "Writing Flex image file %s\n", filename);
 	printf( "Flex Volume Name '%s' (Vol # %d) ",volname, dsknum);
@@ -353,7 +362,12 @@ int main(int argc, char *argv[])
 		}
 		write( fd, bloc, 256);
 	}
+	// Only whole sectors are written
+	flstat.wbytes = lseek( fd, 0, SEEK_CUR);
+	flstat.syscalls += flstat.wbytes / 256 + 2;
+	flstat.sectors = flstat.wbytes / 256;
 	close( fd);
+	stat_stop( PH_FORMAT);
 
 	exit(EXIT_SUCCESS);
 }
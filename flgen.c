@@ -0,0 +1,407 @@
+/* flgen.c -- Synthetic Flex disk images
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+// Images are built directly in memory, without the library tables:
+// the same spec and seed always give the same image, byte for byte.
+
+static uint8_t *img;      // image being built
+static int t0, nbsec;     // geometry of the image being built
+static uint64_t state;    // random generator
+
+//////////////////////////////////////////
+// Deterministic random generator       //
+// (xorshift64*, never seeded with 0)   //
+//////////////////////////////////////////
+
+static uint32_t rnd( void) {
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  return (state * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+// Track and sector of a bloc of the image being built
+
+static uint8_t gtrk( int ibloc) {
+  return ibloc < t0 ? 0 : (ibloc - t0) / nbsec + 1;
+}
+
+static uint8_t gsec( int ibloc) {
+  return ibloc < t0 ? ibloc + 1 : (ibloc - t0) % nbsec + 1;
+}
+
+// Link bloc ibloc to bloc next (0 = end of chain)
+
+static void setlink( int ibloc, int next) {
+  uint8_t *psec = img + ibloc * SECSIZE;
+
+  psec[0] = next ? gtrk( next) : 0;
+  psec[1] = next ? gsec( next) : 0;
+}
+
+// Fill the data part of a sector with text lines
+
+static void filltext( uint8_t *psec) {
+  int j;
+
+  for (j = 4; j < SECSIZE; j++) {
+    if (rnd() % 48 == 0)
+      psec[j] = '\r';
+    else if (rnd() % 7 == 0)
+      psec[j] = ' ';
+    else
+      psec[j] = 'A' + rnd() % 26;
+  }
+}
+
+//////////////////////////////////////////////////////
+// Write the map of a random file: triplets (track, //
+// sector, count) of the data sectors, in the two   //
+// first sectors of the file                        //
+//////////////////////////////////////////////////////
+
+static void setmap( int *chain, int len) {
+  uint8_t *base, *map;
+  int i, count;
+
+  map = img + chain[0] * SECSIZE;
+  base = map + 4;
+  for (i = 2; i < len; i += count) {
+    for (count = 1; i + count < len && count < 255; count++)
+      if (chain[i + count] != chain[i + count - 1] + 1)
+        break;
+    if (base + 3 > map + SECSIZE) {
+      if (map == img + chain[1] * SECSIZE)
+        return;                  // map full, can't happen with short files
+      map = img + chain[1] * SECSIZE;
+      base = map + 4;
+    }
+    base[0] = gtrk( chain[i]);
+    base[1] = gsec( chain[i]);
+    base[2] = count;
+    base += 3;
+  }
+}
+
+///////////////////////////////////////////////////////
+// Build an image following spec, with seed for the  //
+// random choices. Return the image (malloc'ed) and  //
+// its size in sectors, or NULL if spec is not valid //
+///////////////////////////////////////////////////////
+
+uint8_t *gen_image( struct Genspec *spec, uint64_t seed, int *nb_sectors) {
+
+  int nb, ndata;          // sectors in image, data sectors
+  int *order;             // data blocs in allocation order
+  int *dirblk;            // directory blocs
+  int nent, ndir;         // directory entries and blocs
+  int *delstart, *delend; // chains of deleted files
+  int free_first, free_last, nfree;
+  int avail, base, len, seq, live;
+  int e, i, k, p, ndel, nrnd;
+  struct Entry *entry;
+  int *chain;
+  char name[9];
+  int isdel, israndom;
+
+  nbsec = spec->nbsec;
+  t0 = spec->track0 ? spec->track0 : spec->nbsec;
+  if (spec->nbtrk < 2 || spec->nbtrk > 256 || nbsec < 1 || nbsec > 255 ||
+      t0 < 5 || t0 > 255)
+    return NULL;
+  nb = t0 + (spec->nbtrk - 1) * nbsec;
+  ndata = nb - t0;
+  state = seed ? seed : 1;
+
+  img = calloc( nb, SECSIZE);
+  order = malloc( sizeof( int) * ndata);
+  nent = spec->nfiles + spec->ndeleted;
+  dirblk = malloc( sizeof( int) * (t0 + nent / 10 + 1));
+  delstart = malloc( sizeof( int) * (spec->ndeleted + 1));
+  delend = malloc( sizeof( int) * (spec->ndeleted + 1));
+  if (img == NULL || order == NULL || dirblk == NULL || delstart == NULL || delend == NULL) {
+    perror( "gen_image");
+    exit( 3);
+  }
+
+// Fragmentation: swap random pairs of data blocs
+  for (i = 0; i < ndata; i++)
+    order[i] = t0 + i;
+  for (i = 0; i < (long)ndata * spec->frag / 200; i++) {
+    k = rnd() % ndata;
+    p = rnd() % ndata;
+    e = order[k];
+    order[k] = order[p];
+    order[p] = e;
+  }
+
+// Directory: track 0 from sector 5, then data blocs if needed
+  ndir = 0;
+  for (i = 4; i < t0; i++)
+    dirblk[ndir++] = i;
+  p = 0;
+  while (ndir * 10 < nent && p < ndata)
+    dirblk[ndir++] = order[p++];
+  for (i = 0; i < ndir; i++)
+    setlink( dirblk[i], i + 1 < ndir ? dirblk[i+1] : 0);
+
+// Files: about the same share of the space used for each one
+  avail = ndata - p;
+  base = nent ? (long)avail * spec->fill / 100 / nent : 0;
+  ndel = nrnd = live = 0;
+  for (e = 0; e < nent && e < ndir * 10; e++) {
+    isdel = spec->ndeleted && (long)e * spec->ndeleted / nent !=
+            (long)(e + 1) * spec->ndeleted / nent;
+    israndom = !isdel && nrnd < spec->nrandom && spec->nfiles &&
+            (long)(e - ndel) * spec->nrandom / spec->nfiles !=
+            (long)(e - ndel + 1) * spec->nrandom / spec->nfiles;
+    len = base / 2 + (base ? rnd() % (base + 1) : 0);
+    if (israndom) {     // short enough for a one sector map
+      if (len > 80)
+        len = 80;
+      len += 2;
+    }
+    if (len < 1)
+      len = 1;
+    if (p + len > ndata)
+      break;            // disk full
+
+    chain = order + p;
+    p += len;
+    for (i = 0; i < len; i++) {
+      setlink( chain[i], i + 1 < len ? chain[i+1] : 0);
+      if (israndom && i < 2)
+        continue;       // map sectors have no sequence number
+      seq = israndom ? i - 1 : i + 1;
+      img[chain[i] * SECSIZE + 2] = seq >> 8;
+      img[chain[i] * SECSIZE + 3] = seq & 0xFF;
+      filltext( img + chain[i] * SECSIZE);
+    }
+    if (israndom)
+      setmap( chain, len);
+
+    entry = (struct Entry *)(img + dirblk[e / 10] * SECSIZE + 16) + e % 10;
+    snprintf( name, sizeof( name), "F%05d", e % 100000);   // 8 chars at most
+    memcpy( entry->name, name, strlen( name));
+    memcpy( entry->ext, israndom ? "DAT" : "TXT", 3);
+    entry->first_trk = gtrk( chain[0]);
+    entry->first_sec = gsec( chain[0]);
+    entry->last_trk = gtrk( chain[len-1]);
+    entry->last_sec = gsec( chain[len-1]);
+    entry->length[0] = len >> 8;
+    entry->length[1] = len & 0xFF;
+    entry->flags = israndom ? 2 : 0;
+    entry->f_month = 1 + e % 12;
+    entry->f_day = 1 + e % 28;
+    entry->f_year = 86;
+    if (isdel) {
+      entry->name[0] = 0xFF;
+      delstart[ndel] = chain[0];
+      delend[ndel++] = chain[len-1];
+    } else {
+      nrnd += israndom;
+      live += len;
+    }
+  }
+  spec->nfiles = e - ndel;  // what was really built
+  spec->ndeleted = ndel;
+  spec->nrandom = nrnd;
+  spec->used = live;
+
+// Free list: the unused blocs, then the chains of deleted files
+  free_first = free_last = 0;
+  nfree = 0;
+  for (; p < ndata; p++) {
+    if (free_last)
+      setlink( free_last, order[p]);
+    else
+      free_first = order[p];
+    free_last = order[p];
+    setlink( free_last, 0);
+    nfree++;
+  }
+  for (k = 0; k < ndel; k++) {
+    if (free_last)
+      setlink( free_last, delstart[k]);
+    else
+      free_first = delstart[k];
+    free_last = delend[k];
+  }
+  for (e = 0; e < nent && e < ndir * 10; e++) {
+    entry = (struct Entry *)(img + dirblk[e / 10] * SECSIZE + 16) + e % 10;
+    if (entry->name[0] == 0xFF)
+      nfree += entry->length[0] * 256 + entry->length[1];
+  }
+
+// System Information Record
+  for (i = 0; i < 11 && spec->name[i]; i++)
+    img[0x210 + i] = isalnum( spec->name[i]) ? toupper( spec->name[i]) : '_';
+  img[0x21b] = seed >> 8 & 0xFF;
+  img[0x21c] = seed & 0xFF;
+  img[0x21d] = free_first ? gtrk( free_first) : 0;
+  img[0x21e] = free_first ? gsec( free_first) : 0;
+  img[0x21f] = free_last ? gtrk( free_last) : 0;
+  img[0x220] = free_last ? gsec( free_last) : 0;
+  img[0x221] = nfree >> 8;
+  img[0x222] = nfree & 0xFF;
+  img[0x223] = 1;
+  img[0x224] = 1;
+  img[0x225] = 86;
+  img[0x226] = spec->nbtrk - 1;
+  img[0x227] = nbsec;
+
+  free( order);
+  free( dirblk);
+  free( delstart);
+  free( delend);
+  *nb_sectors = nb;
+  return img;
+}
+
+// Names of the damages done by gen_hostile()
+
+char *hostile_name[NB_HOSTILE] = {
+  "crosslink", "selfloop", "freecycle", "dirchain", "badlen"
+};
+
+// Bloc of a track/sector of the image being built
+
+static int gblk( uint8_t trk, uint8_t sec) {
+  return trk == 0 ? sec - 1 : t0 + (trk - 1) * nbsec + sec - 1;
+}
+
+static int getlink( int ibloc) {
+  uint8_t *psec = img + ibloc * SECSIZE;
+
+  return psec[0] || psec[1] ? gblk( psec[0], psec[1]) : 0;
+}
+
+////////////////////////////////////////////////////////
+// Build a damaged image: a normal one is generated,   //
+// then its chains are broken following kind:          //
+// H_CROSSLINK: files chained one to the other, in a   //
+//   cycle, with a maximal length                      //
+// H_SELFLOOP: each file loops back on its first bloc  //
+// H_FREECYCLE: the freelist loops, deleted files with //
+//   a maximal length point in it                      //
+// H_DIRCHAIN: the directory is chained through the    //
+//   whole disk, with entries pointing anywhere        //
+// H_BADLEN: lengths that don't match the chains       //
+////////////////////////////////////////////////////////
+
+uint8_t *gen_hostile( int kind, struct Genspec *spec, uint64_t seed, int *nb_sectors) {
+
+  struct Entry *entry;
+  int ibloc, first, last, prev_last, first_start;
+  int n, e, nb;
+  char name[12];
+
+  if (kind == H_DIRCHAIN)
+    spec->nfiles = spec->ndeleted = spec->nrandom = spec->fill = 0;
+  if (gen_image( spec, seed, &nb) == NULL)
+    return NULL;
+  *nb_sectors = nb;
+
+  if (kind == H_FREECYCLE || kind == H_DIRCHAIN) {
+    first = gblk( img[0x21d], img[0x21e]);
+    last = gblk( img[0x21f], img[0x220]);
+    if (kind == H_FREECYCLE)
+      setlink( last, first);
+  }
+  if (kind == H_DIRCHAIN) {
+// Directory: track 0, then the freelist, that is all the data blocs
+    setlink( t0 - 1, first);
+    for (ibloc = first, n = 0; ibloc > 0 && n < nb - t0; ibloc = getlink( ibloc), n++) {
+      for (e = 0; e < 10; e++) {
+        entry = (struct Entry *)(img + ibloc * SECSIZE + 16) + e;
+        snprintf( name, sizeof( name), "D%07d", n * 10 + e);
+        memcpy( entry->name, name, 8);
+        memcpy( entry->ext, "TXT", 3);
+        first = t0 + rnd() % (nb - t0);
+        entry->first_trk = gtrk( first);
+        entry->first_sec = gsec( first);
+        entry->last_trk = entry->first_trk;
+        entry->last_sec = entry->first_sec;
+        entry->length[0] = entry->length[1] = 0xFF;
+      }
+    }
+    return img;
+  }
+
+// Damage the files, following the directory chain
+  prev_last = first_start = -1;
+  n = 0;
+  for (ibloc = 4; ibloc > 0 && n < nb; ibloc = getlink( ibloc), n++) {
+    for (e = 0; e < 10; e++) {
+      entry = (struct Entry *)(img + ibloc * SECSIZE + 16) + e;
+      if (entry->name[0] == 0)
+        continue;
+      first = gblk( entry->first_trk, entry->first_sec);
+      last = gblk( entry->last_trk, entry->last_sec);
+      if (entry->name[0] == 0xFF) {
+        if (kind == H_FREECYCLE)
+          entry->length[0] = entry->length[1] = 0xFF;
+        continue;
+      }
+      switch (kind) {
+      case H_CROSSLINK:
+        if (prev_last >= 0)
+          setlink( prev_last, first);
+        else
+          first_start = first;
+        prev_last = last;
+        entry->length[0] = entry->length[1] = 0xFF;
+        break;
+      case H_SELFLOOP:
+        setlink( last, first);
+        break;
+      case H_BADLEN:
+        if (rnd() & 1)
+          entry->length[0] = entry->length[1] = 0xFF;
+        else {
+          entry->length[0] = 0;
+          entry->length[1] = 1;
+        }
+        break;
+      }
+    }
+  }
+  if (kind == H_CROSSLINK && prev_last >= 0)
+    setlink( prev_last, first_start);
+  return img;
+}
+
+/////////////////////////////////////////////////
+// Write a generated image, return 0 if OK     //
+/////////////////////////////////////////////////
+
+int write_image( char *filepath, uint8_t *dsk, int nb_sectors) {
+  FILE *out;
+
+  if ((out = fopen( filepath, "wb")) == NULL) {
+    perror( filepath);
+    return 3;
+  }
+  if (fwrite( dsk, SECSIZE, nb_sectors, out) != nb_sectors) {
+    perror( filepath);
+    fclose( out);
+    return 3;
+  }
+  return fclose( out) ? 3 : 0;
+}
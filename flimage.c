@@ -0,0 +1,260 @@
+/* flimage.c -- Flex image loading and saving
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+/////////////////////////////////////////////////////
+// Read n sectors starting at bloc first in memory //
+// Only used when the image is partially loaded    //
+// Return 0 if OK, -1 if the image can't be read   //
+/////////////////////////////////////////////////////
+
+int read_sectors( int first, int n) {
+  ssize_t len;
+
+  if (first + n > disk.nb_sectors)
+    n = disk.nb_sectors - first;
+  if (n <= 0)
+    return 0;
+  stat_start( PH_LOAD);
+  len = pread( disk.fd, disk.dsk + first * SECSIZE, n * SECSIZE, (off_t)first * SECSIZE);
+  stat_stop( PH_LOAD);
+  flstat.syscalls++;
+  if (len != n * SECSIZE) {
+    if (len < 0)
+      perror( disk.shortname);
+    else
+      fprintf( stderr, "%s: short read at sector %d\n", disk.shortname, first);
+    return -1;
+  }
+  flstat.rbytes += len;
+  memset( disk.loaded + first, 1, n);
+  read_overlay( first, n);
+  return 0;
+}
+
+//////////////////////////////////////////////////////
+// Pointer on a sector in memory, read it if needed //
+// A sector that can't be read ends the program     //
+// with 3, as an image that can't be loaded         //
+//////////////////////////////////////////////////////
+
+uint8_t *getsec( int ibloc) {
+  flstat.sectors++;
+  if (disk.loaded != NULL && !disk.loaded[ibloc] && read_sectors( ibloc, 1))
+    exit( 3);
+  return disk.dsk + ibloc * SECSIZE;
+}
+
+/////////////////////////////////////////////////////////
+// Load a disk image in memory                         //
+// If partial, only the boot sectors and SIR are read, //
+// other sectors are read when accessed by getsec()    //
+// An overlay is read through: its base image is read  //
+// and the sectors of the overlay replace its own      //
+// Return 0 if OK, 3 if the image can't be read        //
+/////////////////////////////////////////////////////////
+
+int load_image( char *filepath, int partial) {
+
+  struct stat dsk_stat;
+
+  flstat.syscalls += 2;     // stat and open
+  if (stat( filepath, &dsk_stat)) {
+    perror( filepath);
+    return 3;
+  }
+
+  disk.shortname = strrchr( filepath, '/');
+  if (disk.shortname == NULL)
+    disk.shortname = filepath;
+  else
+    disk.shortname++;
+
+  if ((disk.fd = open( filepath, O_RDONLY)) < 0 ) {
+    perror( filepath);
+    return 3;
+  }
+  if (open_overlay( filepath, &dsk_stat))
+    return 3;
+
+  disk.size = dsk_stat.st_size;
+  disk.nb_sectors = disk.size / SECSIZE;
+  disk.loaded = NULL;
+
+  if (!partial) {
+    if ((disk.dsk = malloc( disk.size)) == NULL) {
+      perror( "malloc: ");
+      return 3;
+    }
+    stat_start( PH_LOAD);
+    if (read( disk.fd, disk.dsk, disk.size) != disk.size) {
+      perror( filepath);
+      return 3;
+    }
+    stat_stop( PH_LOAD);
+    flstat.rbytes += disk.size;
+    flstat.syscalls += 2;
+    read_overlay( 0, disk.nb_sectors);
+    close( disk.fd);
+    disk.fd = -1;
+    return 0;
+  }
+
+// Sectors not read are never touched: calloc'ed pages stay virtual
+  disk.dsk = calloc( 1, disk.size);
+  disk.loaded = calloc( 1, disk.nb_sectors + 1);
+  if (disk.dsk == NULL || disk.loaded == NULL) {
+    perror( "malloc: ");
+    return 3;
+  }
+  if (read_sectors( 0, 3))
+    return 3;
+  return 0;
+}
+
+////////////////////////////////////////////////////
+// Read the whole image if it was partially read  //
+////////////////////////////////////////////////////
+
+int load_all( void) {
+  int first, last;
+
+  if (disk.loaded == NULL)
+    return 0;
+  for (first = 0; first < disk.nb_sectors; first = last) {
+    while (first < disk.nb_sectors && disk.loaded[first])
+      first++;
+    for (last = first; last < disk.nb_sectors && !disk.loaded[last]; last++)
+      ;
+    if (last > first && read_sectors( first, last - first))
+      return -1;
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////
+// Write back a modified image, the original is    //
+// kept with ".bak" appended to its name. For an   //
+// overlay, it is the overlay that is rewritten    //
+// Return 0 if OK, 3 if the image can't be written //
+/////////////////////////////////////////////////////
+
+int save_image( char *filepath) {
+  char *backup;
+  int fd;
+
+  stat_start( PH_WRITE);
+  if (disk.base != NULL) {
+    fd = save_overlay( filepath);
+    stat_stop( PH_WRITE);
+    drop_cache( filepath);
+    return fd;
+  }
+  backup = malloc( strlen( filepath) + 5);
+  strcpy( backup, filepath);
+  strcat( backup, ".bak");
+  if (rename( filepath, backup)) {
+    perror( backup);
+    free( backup);
+    stat_stop( PH_WRITE);
+    return 3;
+  }
+  free( backup);
+
+  fd = creat( filepath, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+  if (fd == -1) {
+    perror( "create: ");
+    stat_stop( PH_WRITE);
+    return 3;
+  }
+  if (write( fd, disk.dsk, disk.size) != disk.size) {
+    perror( "rewrite: ");
+    close( fd);
+    stat_stop( PH_WRITE);
+    return 3;
+  }
+  close( fd);
+  flstat.wbytes += disk.size;
+  flstat.syscalls += 4;     // rename, creat, write and close
+  stat_stop( PH_WRITE);
+
+// The cached analyse doesn't match any more
+  drop_cache( filepath);
+  return 0;
+}
+
+////////////////////////////////////////////////////////
+// Write n sectors of the image in memory back in place //
+// in the image file, without rewriting the rest of it  //
+// (in the overlay if it is one, never in its base)     //
+// Return 0 if OK, 3 if the image can't be written      //
+////////////////////////////////////////////////////////
+
+int write_sectors( char *filepath, int first, int n) {
+  ssize_t len;
+  int fd;
+
+  stat_start( PH_WRITE);
+  if (disk.base != NULL) {
+    len = write_overlay( filepath, first, n);
+    stat_stop( PH_WRITE);
+  } else {
+    if ((fd = open( filepath, O_WRONLY)) < 0) {
+      perror( filepath);
+      stat_stop( PH_WRITE);
+      return 3;
+    }
+    len = pwrite( fd, disk.dsk + first * SECSIZE, n * SECSIZE, (off_t)first * SECSIZE);
+    close( fd);
+    flstat.syscalls += 3;     // open, pwrite and close
+    stat_stop( PH_WRITE);
+    if (len == n * SECSIZE)
+      flstat.wbytes += len;
+  }
+  if (len != n * SECSIZE) {
+    perror( filepath);
+    return 3;
+  }
+
+  drop_cache( filepath);
+  return 0;
+}
+
+//////////////////////////////////////////////////////
+// Release the image and the analyse tables so that //
+// another image can be loaded                      //
+//////////////////////////////////////////////////////
+
+void close_image( void) {
+  if (disk.fd >= 0)
+    close( disk.fd);
+  disk.fd = -1;
+  free( disk.dsk);
+  free( disk.loaded);
+  free( file);
+  free( tabsec);
+  free( nxtsec);
+  close_overlay();
+  disk.dsk = NULL;
+  disk.loaded = NULL;
+  file = NULL;
+  tabsec = NULL;
+  nxtsec = NULL;
+  nfile = nslot = ndel = 0;
+  usedsec = notused = notdir = 0;
+}
@@ -0,0 +1,124 @@
+/* flls.c -- Flex floppy catalog listing
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+int verbose = 0; // more details when verbose increase
+int quiet = 1;   // by default don't give disk infos
+
+char *s_err = "",   // If color is supported => errmsg in red
+     *s_warn = "",  // warnings in yellow
+     *s_norm = "";  // return to normal
+
+void usage( char *cmd) {
+	fprintf( stderr, "Usage: %s [-h] => this help\n", cmd);
+	fprintf( stderr, "       %s [-l] [-v] <disk image>...\n", cmd);
+    fprintf( stderr, "Options:\n");
+	fprintf( stderr, "   -l => long listing (sectors, size, date and flags of files)\n");
+	fprintf( stderr, "   -v => print details about the disk images\n");
+	fprintf( stderr, "   --stats[=json] => print timings and counters on stderr\n");
+}
+
+// List the directory of one image, reading only track 0 and
+// the directory sectors chained beyond it
+
+int catalog( char *filepath, int details) {
+
+  int retval;
+
+  if (load_image( filepath, 1))
+	return 3;
+
+  if (! isFlex( disk.dsk, disk.nb_sectors)) {
+	close_image();
+	return 2;
+  }
+
+  retval = badFlex( 0);
+  if (retval > 1 && retval != 257) {
+	close_image();
+	return retval;
+  }
+
+  if ((retval = analyse_dir( verbose)) > 2) {
+	close_image();
+	return retval;
+  }
+
+  printf( "%s: '%s' #%u", filepath, disk.label, disk.volnum);
+  printf( ", %d free sectors", disk.freesec);
+  list_files( details);
+
+  close_image();
+  return retval;
+}
+
+// Program start here
+int main( int argc, char **argv)
+{
+  char *term, *getenv( const char *name);
+  static struct option longopts[] = { STATS_OPTION, { 0, 0, 0, 0 } };
+  int opt;
+  int details = 0;
+  int retval = 0, done;
+
+  while ((opt = getopt_long( argc, argv, "hlv", longopts, NULL)) != -1) {
+	switch (opt) {
+	case 'h':
+	  usage( *argv);
+	  exit( 0);
+	  break;
+	case 'l':
+	  details = 1;
+	  break;
+	case 'v':
+	  verbose++;
+	  quiet = 0;
+	  break;
+	case 'S':
+	  stats_init( *argv, optarg);
+	  break;
+	default: /* '?' */
+	  usage( *argv);
+	  exit( 3);
+	}
+  }
+
+  if (optind >= argc) {
+	fprintf( stderr, "No file name ???\n");
+	usage( *argv);
+	exit( 3);
+  }
+
+// If possible, colorize Warnings and Errors
+  if (isatty( 1) && (term = getenv( "TERM")) != NULL) {
+    if (strstr( term, "256color") != NULL) {
+      s_warn = "\e[1;93m";
+      s_err  = "\e[1;91m";
+      s_norm = "\e[0m";
+    }
+  }
+
+  for (; optind < argc; optind++) {
+	done = catalog( argv[optind], details);
+	if (done > retval)
+	  retval = done;
+	if (optind < argc - 1)
+	  putchar( '\n');
+  }
+  return retval;
+}
@@ -0,0 +1,421 @@
+/* floverlay.c -- Copy-on-write overlays of Flex disk images
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+// An overlay file stands for its base image with some sectors
+// changed: the base is never written, the sectors written go
+// to the overlay. It is a header, then a record per sector
+// (no sector twice). Numbers are little endian.
+//   0  "FLEXOVL1"
+//   8  number of sectors of the base image
+//  12  0
+//  16  modification time of the base image when last in sync
+//  24  absolute path of the base image, NUL terminated
+// Record: sector number (4 bytes), CRC32C of the sector (4 bytes),
+// the sector.
+
+#define OVL_MAGIC "FLEXOVL1"
+#define OVL_PATH 24
+#define OVL_REC (8 + SECSIZE)
+
+static uint8_t *ovl;         // copy of the overlay file
+static long ovlsize;         // its size
+static long *ovlidx;         // offset of the record of each sector, 0 if none
+
+static void put32( uint8_t *p, uint32_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static uint32_t get32( uint8_t *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void put64( uint8_t *p, int64_t v) {
+  put32( p, v);
+  put32( p + 4, (uint64_t)v >> 32);
+}
+
+static int64_t get64( uint8_t *p) {
+  return get32( p) | (int64_t)get32( p + 4) << 32;
+}
+
+// Read the whole file fd in *buf, return its size or -1 (*buf NULL)
+
+static long read_whole( int fd, uint8_t **buf) {
+  struct stat st;
+
+  *buf = NULL;
+  flstat.syscalls += 2;
+  if (fstat( fd, &st) < 0 || (*buf = malloc( st.st_size + 1)) == NULL)
+    return -1;
+  if (pread( fd, *buf, st.st_size, 0) != st.st_size) {
+    free( *buf);
+    *buf = NULL;
+    return -1;
+  }
+  flstat.rbytes += st.st_size;
+  return st.st_size;
+}
+
+// Error in open_overlay(): the overlay is released, fd and disk.fd
+// are closed
+
+static int bad_overlay( int fd) {
+  if (fd >= 0)
+    close( fd);
+  close( disk.fd);
+  disk.fd = -1;
+  close_overlay();
+  return 3;
+}
+
+////////////////////////////////////////////////////////////
+// If disk.fd is an overlay, read it and open its base    //
+// image in its place: disk.fd and *dsk_stat are then     //
+// those of the base, disk.base its path. Each record is  //
+// verified, a last record cut by a crash is ignored.     //
+// Return 0 if OK (or not an overlay), 3 if the overlay   //
+// or its base can't be read, then disk.fd is closed      //
+////////////////////////////////////////////////////////////
+
+int open_overlay( char *filepath, struct stat *dsk_stat) {
+  uint8_t magic[8];
+  long pos;
+  uint32_t ibloc, nb;
+  int fd;
+
+  disk.base = NULL;
+  flstat.syscalls++;
+  if (pread( disk.fd, magic, 8, 0) != 8 || memcmp( magic, OVL_MAGIC, 8) != 0)
+    return 0;
+  if ((ovlsize = read_whole( disk.fd, &ovl)) < SECSIZE || memchr( ovl + OVL_PATH, 0, SECSIZE - OVL_PATH) == NULL) {
+    fprintf( stderr, "%s: overlay not valid\n", filepath);
+    return bad_overlay( -1);
+  }
+  nb = get32( ovl + 8);
+
+  disk.base = (char *)ovl + OVL_PATH;
+  flstat.syscalls += 3;     // close, open and fstat
+  if ((fd = open( disk.base, O_RDONLY)) < 0 || fstat( fd, dsk_stat) < 0) {
+    perror( disk.base);
+    return bad_overlay( fd);
+  }
+  close( disk.fd);
+  disk.fd = fd;
+  if (dsk_stat->st_size != (off_t)nb * SECSIZE) {
+    fprintf( stderr, "%s: base image %s is no more of %u sectors\n", filepath, disk.base, nb);
+    return bad_overlay( -1);
+  }
+  if (dsk_stat->st_mtim.tv_sec != get64( ovl + 16) && !quiet)
+    printf( "%sWarning: base image %s changed since the overlay was made%s\n",
+      s_warn, disk.base, s_norm);
+
+  if ((ovlidx = calloc( (size_t)nb + 1, sizeof( long))) == NULL) {
+    perror( "calloc: ");
+    return bad_overlay( -1);
+  }
+  for (pos = SECSIZE; pos + OVL_REC <= ovlsize; pos += OVL_REC) {
+    ibloc = get32( ovl + pos);     // unsigned: a number past 2^31 is out of range too
+    if (ibloc >= nb || get32( ovl + pos + 4) != crc32c( 0, ovl + pos + 8, SECSIZE)) {
+      fprintf( stderr, "%s: overlay damaged at offset %ld\n", filepath, pos);
+      return bad_overlay( -1);
+    }
+    ovlidx[ibloc] = pos + 8;
+  }
+  if (pos != ovlsize)
+    fprintf( stderr, "%s: last record of the overlay is cut, ignored\n", filepath);
+  ovlsize = pos;
+  return 0;
+}
+
+// Sectors first to first+n-1 read from the base get their overlay
+
+void read_overlay( int first, int n) {
+  int ibloc;
+
+  for (ibloc = first; ibloc < first + n && ovlidx != NULL; ibloc++)
+    if (ovlidx[ibloc])
+      memcpy( disk.dsk + ibloc * SECSIZE, ovl + ovlidx[ibloc], SECSIZE);
+}
+
+////////////////////////////////////////////////////////////
+// Write sectors first to first+n-1 of the image in       //
+// memory in the overlay: a sector already there is       //
+// rewritten in place, the others are appended.           //
+// Return the number of bytes of sectors written, -1 if   //
+// the overlay can't be written                           //
+////////////////////////////////////////////////////////////
+
+int write_overlay( char *filepath, int first, int n) {
+  uint8_t *rec;
+  long pos, end;
+  int fd, ibloc, len = 0;
+
+  flstat.syscalls += 2;     // open and close
+  if ((fd = open( filepath, O_WRONLY)) < 0)
+    return -1;
+  end = ovlsize;
+  for (ibloc = first; ibloc < first + n; ibloc++) {
+    if ((pos = ovlidx[ibloc] - 8) < 0) {
+      if ((rec = realloc( ovl, ovlsize + OVL_REC)) == NULL)
+        break;
+      ovl = rec;
+      disk.base = (char *)ovl + OVL_PATH;
+      pos = ovlsize;
+      ovlsize += OVL_REC;
+      ovlidx[ibloc] = pos + 8;
+    }
+    rec = ovl + pos;
+    put32( rec, ibloc);
+    put32( rec + 4, crc32c( 0, disk.dsk + ibloc * SECSIZE, SECSIZE));
+    memcpy( rec + 8, disk.dsk + ibloc * SECSIZE, SECSIZE);
+    if (pos < end) {        // in place
+      flstat.syscalls++;
+      if (pwrite( fd, rec, OVL_REC, pos) != OVL_REC)
+        break;
+      len += SECSIZE;
+    }
+    if (disk.loaded != NULL)
+      disk.loaded[ibloc] = 1;
+  }
+// New records in one write
+  if (ibloc == first + n && ovlsize > end) {
+    flstat.syscalls++;
+    if (pwrite( fd, ovl + end, ovlsize - end, end) == ovlsize - end)
+      len += (ovlsize - end) / OVL_REC * SECSIZE;
+  }
+  close( fd);
+  flstat.wbytes += len / SECSIZE * OVL_REC;
+  return len;
+}
+
+////////////////////////////////////////////////////////////
+// Rewrite the overlay for the whole image in memory: the //
+// old one is kept with ".bak" appended to its name, the  //
+// new one has the sectors that differ from the base only //
+// The records are built before the old file is renamed: //
+// on any error, the overlay file and the one in memory   //
+// are left as they were                                  //
+// Return 0 if OK, 3 if it can't be written               //
+////////////////////////////////////////////////////////////
+
+int save_overlay( char *filepath) {
+  uint8_t *buf, *rec, *nov;
+  long *nidx, nsize;
+  char *backup;
+  int fd, bfd, ibloc, n, len, err;
+
+  if ((bfd = open( disk.base, O_RDONLY)) < 0 || (buf = malloc( 64 * SECSIZE)) == NULL) {
+    perror( disk.base);
+    return 3;
+  }
+  nidx = calloc( disk.nb_sectors + 1, sizeof( long));
+  if (nidx == NULL || (nov = malloc( SECSIZE)) == NULL) {
+    perror( "malloc: ");
+    free( nidx);
+    free( buf);
+    close( bfd);
+    return 3;
+  }
+  flstat.syscalls++;        // open
+
+// The header is kept, the records are rebuilt in nov
+  memcpy( nov, ovl, SECSIZE);
+  nsize = SECSIZE;
+  for (ibloc = 0; ibloc < disk.nb_sectors; ibloc += n) {
+    n = disk.nb_sectors - ibloc < 64 ? disk.nb_sectors - ibloc : 64;
+    flstat.syscalls++;
+    if ((len = pread( bfd, buf, n * SECSIZE, (off_t)ibloc * SECSIZE)) != n * SECSIZE) {
+      if (len < 0)
+        perror( disk.base);
+      else
+        fprintf( stderr, "%s: short read at sector %d\n", disk.base, ibloc);
+      break;
+    }
+    flstat.rbytes += n * SECSIZE;
+    for (len = 0; len < n; len++)
+      if (memcmp( buf + len * SECSIZE, disk.dsk + (ibloc + len) * SECSIZE, SECSIZE) != 0) {
+        if ((rec = realloc( nov, nsize + OVL_REC)) == NULL) {
+          perror( "realloc: ");
+          break;
+        }
+        nov = rec;
+        rec = nov + nsize;
+        put32( rec, ibloc + len);
+        put32( rec + 4, crc32c( 0, disk.dsk + (ibloc + len) * SECSIZE, SECSIZE));
+        memcpy( rec + 8, disk.dsk + (ibloc + len) * SECSIZE, SECSIZE);
+        nidx[ibloc + len] = nsize + 8;
+        nsize += OVL_REC;
+      }
+    if (len < n)
+      break;
+  }
+  close( bfd);
+  free( buf);
+  if (ibloc < disk.nb_sectors) {
+    free( nov);
+    free( nidx);
+    return 3;
+  }
+
+// Then the old overlay becomes the backup, put back if the new one can't be written
+  backup = malloc( strlen( filepath) + 5);
+  strcpy( backup, filepath);
+  strcat( backup, ".bak");
+  flstat.syscalls += 4;     // rename, creat, write and close
+  if ((err = rename( filepath, backup)) != 0)
+    perror( backup);
+  else if ((fd = creat( filepath, 0644)) < 0 || write( fd, nov, nsize) != nsize) {
+    perror( filepath);
+    if (fd >= 0)
+      close( fd);
+    rename( backup, filepath);
+    err = 1;
+  } else
+    close( fd);
+  free( backup);
+  if (err) {
+    free( nov);
+    free( nidx);
+    return 3;
+  }
+  flstat.wbytes += nsize;
+
+  free( ovl);
+  free( ovlidx);
+  ovl = nov;
+  ovlidx = nidx;
+  ovlsize = nsize;
+  disk.base = (char *)ovl + OVL_PATH;
+  return 0;
+}
+
+// Release the overlay
+
+void close_overlay( void) {
+  free( ovl);
+  free( ovlidx);
+  ovl = NULL;
+  ovlidx = NULL;
+  disk.base = NULL;
+}
+
+/////////////////////////////////////////////////////////
+// Create the empty overlay filepath of the image base //
+// Return 0 if OK, 3 if it can't be created (or exists) //
+/////////////////////////////////////////////////////////
+
+int create_overlay( char *base, char *filepath) {
+  struct stat st;
+  uint8_t head[SECSIZE];
+  char full[PATH_MAX];
+  int fd;
+
+  if (realpath( base, full) == NULL || stat( full, &st) < 0) {
+    perror( base);
+    return 3;
+  }
+  if (strlen( full) >= SECSIZE - OVL_PATH) {
+    fprintf( stderr, "%s: path too long for an overlay\n", full);
+    return 3;
+  }
+  memset( head, 0, SECSIZE);
+  memcpy( head, OVL_MAGIC, 8);
+  put32( head + 8, st.st_size / SECSIZE);
+  put64( head + 16, st.st_mtim.tv_sec);
+  strcpy( (char *)head + OVL_PATH, full);
+
+  flstat.syscalls += 3;
+  if ((fd = open( filepath, O_WRONLY | O_CREAT | O_EXCL, 0644)) < 0) {
+    perror( filepath);
+    return 3;
+  }
+  if (write( fd, head, SECSIZE) != SECSIZE) {
+    perror( filepath);
+    close( fd);
+    return 3;
+  }
+  close( fd);
+  flstat.wbytes += SECSIZE;
+  return 0;
+}
+
+//////////////////////////////////////////////////////////
+// Empty the overlay filepath (loaded by load_image()): //
+// truncated to its header, it stands for its base      //
+// again. If commit, its sectors are first written in   //
+// the base, in place, and the header takes the new     //
+// date of the base.                                    //
+// Return 0 if OK, 3 if a file can't be written         //
+//////////////////////////////////////////////////////////
+
+int reset_overlay( char *filepath, int commit) {
+  struct stat st;
+  long pos;
+  int fd;
+
+  if (commit) {
+    flstat.syscalls += 3;
+    if ((fd = open( disk.base, O_WRONLY)) < 0) {
+      perror( disk.base);
+      return 3;
+    }
+    for (pos = SECSIZE; pos < ovlsize; pos += OVL_REC) {
+      flstat.syscalls++;
+      if (pwrite( fd, ovl + pos + 8, SECSIZE, (off_t)get32( ovl + pos) * SECSIZE) != SECSIZE) {
+        perror( disk.base);
+        close( fd);
+        return 3;
+      }
+      flstat.wbytes += SECSIZE;
+    }
+    if (fsync( fd) < 0 || fstat( fd, &st) < 0) {
+      perror( disk.base);
+      close( fd);
+      return 3;
+    }
+    close( fd);
+    put64( ovl + 16, st.st_mtim.tv_sec);
+    drop_cache( disk.base);
+  }
+
+  flstat.syscalls += 4;
+  if ((fd = open( filepath, O_WRONLY)) < 0 || pwrite( fd, ovl, SECSIZE, 0) != SECSIZE
+      || ftruncate( fd, SECSIZE) < 0) {
+    perror( filepath);
+    return 3;
+  }
+  close( fd);
+  ovlsize = SECSIZE;
+  memset( ovlidx, 0, disk.nb_sectors * sizeof( long));
+  drop_cache( filepath);
+  return 0;
+}
+
+// Number of sectors in the overlay, in[] gets 1 for each if not NULL
+
+int overlay_sectors( uint8_t *in) {
+  long pos;
+
+  for (pos = SECSIZE; pos < ovlsize && in != NULL; pos += OVL_REC)
+    in[get32( ovl + pos)] = 1;
+  return (ovlsize - SECSIZE) / OVL_REC;
+}
@@ -0,0 +1,131 @@
+/* flovl.c -- Create, commit or discard an overlay of a Flex disk image
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+int verbose = 0; // more details when verbose increase
+int quiet = 1;   // by default don't give disk infos
+
+char *s_err = "",   // If color is supported => errmsg in red
+     *s_warn = "",  // warnings in yellow
+     *s_norm = "";  // return to normal
+
+void usage( char *cmd) {
+	fprintf( stderr, "Usage: %s [-h] => this help\n", cmd);
+	fprintf( stderr, "       %s create <disk image> <overlay> => new empty overlay of the image\n", cmd);
+	fprintf( stderr, "       %s commit <overlay> => write its sectors in the image, and empty it\n", cmd);
+	fprintf( stderr, "       %s discard <overlay> => empty it, back to the image\n", cmd);
+	fprintf( stderr, "       %s [-v] status <overlay> => base image and sectors changed\n", cmd);
+    fprintf( stderr, "Options:\n");
+	fprintf( stderr, "   -v => list the sectors of the overlay\n");
+	fprintf( stderr, "   --stats[=json] => print timings and counters on stderr\n");
+	fprintf( stderr, "An overlay is used by all the tools in place of a disk image\n");
+}
+
+// Program start here
+int main( int argc, char **argv)
+{
+  char *term, *getenv( const char *name);
+  static struct option longopts[] = { STATS_OPTION, { 0, 0, 0, 0 } };
+  int opt;
+  char *cmd, *filepath;
+  uint8_t *in;
+  int ibloc, n;
+  int list = 0;
+  int retval;
+
+  while ((opt = getopt_long( argc, argv, "hv", longopts, NULL)) != -1) {
+	switch (opt) {
+	case 'h':
+	  usage( *argv);
+	  exit( 0);
+	  break;
+	case 'v':
+	  list = 1;
+	  break;
+	case 'S':
+	  stats_init( *argv, optarg);
+	  break;
+	default: /* '?' */
+	  usage( *argv);
+	  exit( 3);
+	}
+  }
+
+  if (argc - optind < 2) {
+	usage( *argv);
+	exit( 3);
+  }
+  cmd = argv[optind];
+  filepath = argv[argc-1];
+  if ((strcmp( cmd, "create") == 0 && argc - optind != 3) || (strcmp( cmd, "create") != 0
+      && (argc - optind != 2 || (strcmp( cmd, "commit") && strcmp( cmd, "discard")
+                                 && strcmp( cmd, "status"))))) {
+	usage( *argv);
+	exit( 3);
+  }
+
+// If possible, colorize Warnings and Errors
+  if (isatty( 1) && (term = getenv( "TERM")) != NULL) {
+    if (strstr( term, "256color") != NULL) {
+      s_warn = "\e[1;93m";
+      s_err  = "\e[1;91m";
+      s_norm = "\e[0m";
+    }
+  }
+
+  if (strcmp( cmd, "create") == 0) {
+	if (load_image( argv[optind+1], 1))
+	  exit( 3);
+	if (! isFlex( disk.dsk, disk.nb_sectors))
+	  exit( 2);
+	if (disk.base != NULL) {
+	  printf( "%sERROR: %s is already an overlay%s\n", s_err, argv[optind+1], s_norm);
+	  exit( 1);
+	}
+	return create_overlay( argv[optind+1], filepath);
+  }
+
+// The overlay is read, not the sectors of its base
+  quiet = 0;
+  if (load_image( filepath, 1))
+	exit( 3);
+  quiet = 1;
+  if (! isFlex( disk.dsk, disk.nb_sectors))
+	exit( 2);
+  badFlex( 0);        // only for the geometry, the sectors are not checked
+  if (disk.base == NULL) {
+	printf( "%sERROR: %s is not an overlay%s\n", s_err, filepath, s_norm);
+	exit( 1);
+  }
+  in = calloc( disk.nb_sectors, 1);
+  n = overlay_sectors( in);
+
+  if (strcmp( cmd, "status") == 0) {
+	printf( "%s: overlay of %s, %d sector%s written\n", filepath, disk.base, n, n > 1 ? "s" : "");
+	for (ibloc = 0; ibloc < disk.nb_sectors && list; ibloc++)
+	  if (in[ibloc])
+		printf( "[%02X/%02X]\n", blk2trk( ibloc), blk2sec( ibloc));
+	return 0;
+  }
+
+  retval = reset_overlay( filepath, strcmp( cmd, "commit") == 0);
+  if (retval == 0)
+	printf( "%s: %d sector%s %s\n", filepath, n, n > 1 ? "s" : "",
+	  strcmp( cmd, "commit") == 0 ? "written in the base image" : "discarded");
+  return retval;
+}
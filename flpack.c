@@ -21,21 +21,27 @@
 #include <stdlib.h>
 #include <getopt.h>
 #include <ctype.h>
+#include "flstats.h"
+#include "flconv.h"
 
 int main ( int argc, char *argv[]) {
 
 	FILE *input, *output;
-	int chin;			// readed char
+	uint8_t inbuf[65536], *outbuf;
+	size_t len, outsize;
+	struct Textconv tc;	// conversion state
 	int tabstop = 8;	// tab stop value
-	int line_length;	// current line length
-	int nspace;			// number of spaces
 	int opt;			// opt value
+	static struct option longopts[] = { STATS_OPTION, { 0, 0, 0, 0 } };
 
-	while ((opt = getopt( argc, argv, "t:")) != -1) {
+	while ((opt = getopt_long( argc, argv, "t:", longopts, NULL)) != -1) {
 		switch (opt) {
 		case 't':
 			sscanf( optarg, "%d", &tabstop);
 			break;
+		case 'S':
+			stats_init( *argv, optarg);
+			break;
 		default:
 			if (optopt == 't')
 				fprintf( stderr, "Option %c requires an argument.\n", optopt);
@@ -43,7 +49,7 @@ int main ( int argc, char *argv[]) {
           		fprintf( stderr, "Unknown option '-%c'.\n", optopt);
       		else
          		fprintf( stderr, "Unknown option character '0x%x'.\n", optopt);
-			fprintf( stderr, "Usage: flpack [-t value] [input [output]]\n");
+			fprintf( stderr, "Usage: flpack [-t value] [--stats[=json]] [input [output]]\n");
 			exit( 1);
 		}
 	}
@@ -67,36 +73,26 @@ int main ( int argc, char *argv[]) {
 		} else
 			output = stdout;
 
-	line_length = 0;
-	nspace = 0;
-	while ((chin = fgetc( input)) != EOF) {
-		if (chin == ' ') {
-			nspace++;
-			line_length++;
-		} else if (chin == '\t') {	// TAB => prepare for multiple spaces
-			nspace += tabstop - (line_length % tabstop);
-			line_length += tabstop - (line_length % tabstop);
-		} else if (chin == '\n') {
-			nspace = 0;				// throw away trailing spaces
-			line_length = 0;		// Line length reinit
-			fputc( '\r', output);	// CR to LF conversion
-		} else {
-			switch (nspace) {		// time to output them
-			case 2:
-			  fputc( ' ', output);
-			case 1:
-			  fputc( ' ', output);
-			case 0:
-			  break;
-			default:
-			  fputc( '\t', output);
-			  fputc( nspace & 0x7f, output);		// won't work if nspace > 127 !!!
-			  break;
-			}
-			nspace = 0;
-			fputc( chin, output);
-			line_length++;
+	stat_start( PH_CONVERT);
+	text_init( &tc, tabstop);
+	outsize = PACK_MAX( &tc, sizeof( inbuf));
+	outbuf = malloc( outsize);
+	while ((len = fread( inbuf, 1, sizeof( inbuf), input)) > 0 && outbuf != NULL) {
+		flstat.rbytes += len;
+		if (PACK_MAX( &tc, len) > outsize) {	// long run of spaces pending
+			outsize = PACK_MAX( &tc, len);
+			outbuf = realloc( outbuf, outsize);
+			if (outbuf == NULL)
+				break;
 		}
+		len = pack_text( &tc, inbuf, len, outbuf);
+		fwrite( outbuf, 1, len, output);
+		flstat.wbytes += len;
+	}
+	if (outbuf == NULL) {
+		perror( "flpack");
+		exit( 1);
 	}
+	stat_stop( PH_CONVERT);
 	exit( 0);
 }
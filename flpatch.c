@@ -0,0 +1,100 @@
+/* flpatch.c -- Apply a patch made by fldiff to a Flex disk image
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+int verbose = 0; // more details when verbose increase
+int quiet = 1;   // by default don't give disk infos
+
+char *s_err = "",   // If color is supported => errmsg in red
+     *s_warn = "",  // warnings in yellow
+     *s_norm = "";  // return to normal
+
+void usage( char *cmd) {
+	fprintf( stderr, "Usage: %s [-h] => this help\n", cmd);
+	fprintf( stderr, "       %s [-v] <patch> <disk image>\n", cmd);
+    fprintf( stderr, "Options:\n");
+	fprintf( stderr, "   -v => print the sectors that don't match the patch\n");
+	fprintf( stderr, "   --stats[=json] => print timings and counters on stderr\n");
+	fprintf( stderr, "Only the sectors of the patch are read and written\n");
+}
+
+// Program start here
+int main( int argc, char **argv)
+{
+  char *term, *getenv( const char *name);
+  static struct option longopts[] = { STATS_OPTION, { 0, 0, 0, 0 } };
+  int opt;
+  char *filepath, *patchpath;
+  uint8_t *patch;
+  long size;
+  int retval;
+
+  while ((opt = getopt_long( argc, argv, "hv", longopts, NULL)) != -1) {
+	switch (opt) {
+	case 'h':
+	  usage( *argv);
+	  exit( 0);
+	  break;
+	case 'v':
+	  verbose = 1;
+	  break;
+	case 'S':
+	  stats_init( *argv, optarg);
+	  break;
+	default: /* '?' */
+	  usage( *argv);
+	  exit( 3);
+	}
+  }
+
+  if (argc - optind != 2) {
+	usage( *argv);
+	exit( 3);
+  }
+  patchpath = argv[optind];
+  filepath = argv[optind+1];
+
+// If possible, colorize Warnings and Errors
+  if (isatty( 1) && (term = getenv( "TERM")) != NULL) {
+    if (strstr( term, "256color") != NULL) {
+      s_warn = "\e[1;93m";
+      s_err  = "\e[1;91m";
+      s_norm = "\e[0m";
+    }
+  }
+
+// Partial load: the sectors of the patch only will be read
+  if (load_image( filepath, 1))
+	exit( 3);
+  if (! isFlex( disk.dsk, disk.nb_sectors))
+	exit( 2);
+  if ((retval = read_patch( patchpath, &patch, &size)) != 0)
+	exit( retval);
+
+  stat_start( PH_WRITE);
+  retval = apply_patch( patch, filepath);
+  stat_stop( PH_WRITE);
+  if (retval < 0) {
+	printf( "%s: patch already applied\n", filepath);
+	retval = 0;
+  } else if (retval == 1)
+	printf( "%sERROR: %s is not the image the patch was made from%s\n", s_err, filepath, s_norm);
+  else if (retval == 0 && verbose)
+	printf( "%s: %ld bytes of patch applied\n", filepath, size);
+  return retval;
+}
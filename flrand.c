@@ -0,0 +1,215 @@
+/* flrand.c -- Record access in Flex random files
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+// The two first sectors of a random file are its map: from byte 4,
+// triplets (track, sector, count) of contiguous data sectors, 84 by
+// sector. Record n (from 1) is the nth data sector, its sequence
+// number is n. The map is at most 168 triplets: a record is found
+// reading the map and the data sector only, whatever the size of
+// the file or of the disk.
+
+#define MAPENT 84    // triplets in a map sector
+
+////////////////////////////////////////////////////////
+// Bloc of record rec of random file k                //
+// Return -1 if the file is not random or rec is out  //
+// of the file, -2 if the map is corrupted            //
+////////////////////////////////////////////////////////
+
+int rec2blk( int k, int rec) {
+  uint8_t *map, *p;
+  int ibloc, first, t;
+
+  if ((file[k].flags & 0x02) == 0 || rec < 1 || rec > file[k].length - 2)
+    return -1;
+  if ((ibloc = ts2blk( file[k].start_trk, file[k].start_sec)) < 1)
+    return -2;
+  map = getsec( ibloc);
+  for (t = 0; t < 2 * MAPENT; t++) {
+    if (t == MAPENT) {      // second sector of the map
+      if ((ibloc = ts2blk( map[0], map[1])) < 1)
+        return -2;
+      map = getsec( ibloc);
+      flstat.hops++;
+    }
+    p = map + 4 + (t % MAPENT) * 3;
+    if (p[2] == 0)          // end of map before the record
+      return -2;
+    if (rec <= p[2]) {
+      first = ts2blk( p[0], p[1]);
+      if (first < 1 || first + rec - 1 >= disk.nb_sectors)
+        return -2;
+      return first + rec - 1;
+    }
+    rec -= p[2];
+  }
+  return -2;
+}
+
+// Bloc of a record, checked with the sequence number of the sector
+
+static int record( int k, int rec) {
+  uint8_t *psec;
+  int ibloc;
+
+  if ((ibloc = rec2blk( k, rec)) < 0)
+    return ibloc;
+  psec = getsec( ibloc);
+  if (psec[2] * 256 + psec[3] != rec) {
+    printf( "%sERROR: File %s, record %d: sector [0x%02X/0x%02X] has sequence number %d%s\n",
+      s_err, file[k].name, rec, blk2trk( ibloc), blk2sec( ibloc), psec[2] * 256 + psec[3], s_norm);
+    return -2;
+  }
+  return ibloc;
+}
+
+/////////////////////////////////////////////////////////
+// Copy record rec of random file k in buf (RECSIZE)   //
+// Return 0 if OK, 1 if not a random file or no such   //
+// record, 2 if the map or the sector is not coherent  //
+/////////////////////////////////////////////////////////
+
+int get_record( int k, int rec, uint8_t *buf) {
+  int ibloc;
+
+  if ((ibloc = record( k, rec)) < 0)
+    return -ibloc;
+  memcpy( buf, getsec( ibloc) + 4, RECSIZE);
+  return 0;
+}
+
+/////////////////////////////////////////////////////////
+// Replace record rec of random file k by buf, only    //
+// this sector is written back in the image file       //
+// Return as get_record(), or 3 if the write failed    //
+/////////////////////////////////////////////////////////
+
+int put_record( char *filepath, int k, int rec, uint8_t *buf) {
+  int ibloc;
+
+  if ((ibloc = record( k, rec)) < 0)
+    return -ibloc;
+  memcpy( getsec( ibloc) + 4, buf, RECSIZE);
+  return write_sectors( filepath, ibloc, 1);
+}
+
+// Triplet t of a map
+
+static void set_run( uint8_t **map, int t, int first, int count) {
+  uint8_t *p = map[t / MAPENT] + 4 + (t % MAPENT) * 3;
+
+  p[0] = blk2trk( first);
+  p[1] = blk2sec( first);
+  p[2] = count;
+}
+
+/////////////////////////////////////////////////////////
+// Write the map of random file k from its chain, with //
+// the longest runs possible (255 sectors by triplet)  //
+// Return 0 if OK, 1 if there are too many runs for    //
+// the map, -1 if the chain is shorter than the file   //
+/////////////////////////////////////////////////////////
+
+int build_map( int k) {
+  uint8_t *map[2];
+  int ibloc, first, count, n, t;
+
+  if ((ibloc = ts2blk( file[k].start_trk, file[k].start_sec)) < 1)
+    return -1;
+  map[0] = getsec( ibloc);
+  if ((ibloc = get_link( ibloc)) < 1)
+    return -1;
+  map[1] = getsec( ibloc);
+  memset( map[0] + 4, 0, RECSIZE);
+  memset( map[1] + 4, 0, RECSIZE);
+
+  t = count = first = 0;
+  for (n = 0; n < file[k].length - 2; n++) {
+    if ((ibloc = get_link( ibloc)) < 1)
+      return -1;
+    if (count && ibloc == first + count && count < 255)
+      count++;
+    else {
+      if (count) {
+        if (t == 2 * MAPENT)
+          return 1;
+        set_run( map, t++, first, count);
+      }
+      first = ibloc;
+      count = 1;
+    }
+  }
+  if (count) {
+    if (t == 2 * MAPENT)
+      return 1;
+    set_run( map, t, first, count);
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////
+// Verify the map of random file k against its chain,  //
+// in one walk of both                                 //
+// Return 0 if the map is right and minimal, 1 if it   //
+// is right but with more triplets than needed, 2 if   //
+// it doesn't match the chain, -1 if the chain is      //
+// shorter than the file                               //
+/////////////////////////////////////////////////////////
+
+int check_map( int k) {
+  uint8_t *map[2], *p;
+  int ibloc, expect, left, first, count, nrun, n, t;
+
+  if ((ibloc = ts2blk( file[k].start_trk, file[k].start_sec)) < 1)
+    return -1;
+  map[0] = getsec( ibloc);
+  if ((ibloc = get_link( ibloc)) < 1)
+    return -1;
+  map[1] = getsec( ibloc);
+
+  t = left = expect = 0;
+  nrun = count = first = 0;
+  for (n = 0; n < file[k].length - 2; n++) {
+    if ((ibloc = get_link( ibloc)) < 1)
+      return -1;
+    if (left == 0) {        // next triplet
+      if (t == 2 * MAPENT)
+        return 2;
+      p = map[t / MAPENT] + 4 + (t % MAPENT) * 3;
+      if ((left = p[2]) == 0)
+        return 2;
+      expect = ts2blk( p[0], p[1]);
+      t++;
+    }
+    if (ibloc != expect)
+      return 2;
+    expect++;
+    left--;
+    if (count && ibloc == first + count && count < 255)   // as build_map()
+      count++;
+    else {
+      nrun++;
+      first = ibloc;
+      count = 1;
+    }
+  }
+  if (left || (t < 2 * MAPENT && map[t / MAPENT][4 + (t % MAPENT) * 3 + 2] != 0))
+    return 2;               // map longer than the file
+  return t > nrun;
+}
@@ -15,6 +15,7 @@
    along with this program; if not, write to the Free Software
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
 
+#include <strings.h>
 #include "dskflex.h"
 
 int verbose = 0; // more details when verbose increase
@@ -26,143 +27,161 @@ char *s_err,     // If color is supported => errmsg in red
 	 *s_ok,		 // OK
      *s_norm;    // return to normal
 
+// Filters on the files selected, 0 if not used
+
+struct Filter {
+  char *ext;         // extensions, comma separated
+  int after;         // date as YYYYMMDD
+  int before;
+  int minsize;       // in sectors
+  int maxsize;
+};
+
 void usage( char *cmd) {
 	fprintf( stderr, "Usage: %s [-h] => this help\n", cmd);
-	fprintf( stderr, "       %s [-c] [-o] [-v] <files>... <disk image>\n", cmd);
+	fprintf( stderr, "       %s [-c] [-o] [-s] [-v] [-d dir] [filters] <files>... <disk image>\n", cmd);
     fprintf( stderr, "Options:\n");
 	fprintf( stderr, "   -c => convert text files from Flex to Unix format\n");
+	fprintf( stderr, "   -d <dir> => write files in dir instead of the current directory\n");
 	fprintf( stderr, "   -o => if a file exists, don't ignore it but replace it\n");
+	fprintf( stderr, "   -s => strict, verify the whole image before extracting files\n");
 	fprintf( stderr, "   -v => print some details and a listing of files on image\n");
+	fprintf( stderr, "   --stats[=json] => print timings and counters on stderr\n");
+	fprintf( stderr, "Files are names or patterns like '*.TXT' (case insensitive)\n");
+	fprintf( stderr, "Filters (all files if no name is given):\n");
+	fprintf( stderr, "   -e <ext>[,<ext>...] => only these extensions\n");
+	fprintf( stderr, "   --after=<YYYY-MM-DD>, --before=<YYYY-MM-DD> => dated from/until\n");
+	fprintf( stderr, "   --min-size=<n>, --max-size=<n> => at least/most n sectors\n");
 }
 
-// Extract file from disk image
-
-int extract_file( char *name, int replace, int convert) {
-
-  FILE *out;
-  struct Entry *entry;
-  struct stat file_stat;
-  uint8_t *current;
-  uint8_t cftrk, cfsec;
-  int j, k;
-  struct utimbuf new_times;
-  struct tm dsktime;
-  time_t itime;
-  int nb_blk;
-  int state;		// manage flex text compression
-  int c;
-  
-// Does file exist ?
-
-  if (strlen( name) > 12)  // incompatible length
-    return 1;
-  for (k = 0; k < strlen( name); k++)
-	fname[k] = toupper( name[k]);
-  fname[k] = 0;
-// Find file
-  k = 0;
-  while (strcmp( file[k].name, fname) != 0 && k < nslot)
-	 k++;
-  if (k == nslot)  // not found
-    return 1;
-
-  if (file[k].name[0] == '?' || (file[k].flags & 0x80) != 0)
-	return 2;
+// Date YYYY-MM-DD as YYYYMMDD, -1 if not valid
 
-  if (convert)
-	for (j = 0; j < 12; j++)
-      fname[j] = tolower( file[k].name[j]);
-
-  if (stat( fname, &file_stat) == 0 && replace == 0)
-	return 3;
-  if ((out = fopen( fname, "wb")) == NULL) {
-	perror( fname);
-	return 4;
+static int parse_date( char *date) {
+  int y, m, d;
+
+  if (sscanf( date, "%d-%d-%d", &y, &m, &d) != 3 || m < 1 || m > 12 || d < 1 || d > 31)
+	return -1;
+  return y * 10000 + m * 100 + d;
+}
+
+// Does file k pass the filters ?
+
+static int filter( int k, struct Filter *f) {
+  char *ext, *p;
+  int date, len;
+
+  date = file[k].year * 10000 + file[k].month * 100 + file[k].day;
+  if ((f->after && date < f->after) || (f->before && date > f->before))
+	return 0;
+  if ((f->minsize && file[k].length < f->minsize) || (f->maxsize && file[k].length > f->maxsize))
+	return 0;
+  if (f->ext == NULL)
+	return 1;
+  if ((ext = strchr( (char *)file[k].name, '.')) == NULL)
+	return 0;
+  ext++;
+  len = strlen( ext);
+  for (p = f->ext; *p != 0; p += strcspn( p, ","), p += *p == ',')
+	if (strcspn( p, ",") == len && strncasecmp( p, ext, len) == 0)
+	  return 1;
+  return 0;
+}
+
+/////////////////////////////////////////////////////////
+// Select files matching one of the patterns (shell    //
+// globs, case insensitive) and the filters, in one    //
+// pass over the file table. sel gets their indexes    //
+// in directory order, found[i] the number of files    //
+// matched by patterns[i]. Return the number selected  //
+/////////////////////////////////////////////////////////
+
+int select_files( char **patterns, struct Filter *f, int *found, int *sel) {
+  char **upper;      // patterns in upper case
+  int np, nsel, i, j, k, match;
+
+  for (np = 0; patterns[np] != NULL; np++)
+	;
+  upper = malloc( np * sizeof( char *));
+  for (i = 0; i < np; i++) {
+	upper[i] = strdup( patterns[i]);
+	for (j = 0; upper[i][j] != 0; j++)
+	  upper[i][j] = toupper( upper[i][j]);
+	found[i] = 0;
   }
-  cftrk = file[k].start_trk;
-  cfsec = file[k].start_sec;
-  current = ts2pos( cftrk, cfsec);
-  if (file[k].flags & 0x02) {
-	fputs( "#FLEX##RAND#", out);
-	j = 16;
-  } else
-	j = 4;
-
-  nb_blk = 0;
-  state = 0;
-  while (nb_blk < file[k].length) {
-	if (ts2blk( cftrk, cfsec) < 1) {
-	  break;
-	}
-	current = ts2pos( cftrk, cfsec);
-	nb_blk++;
-	cftrk = current[0];
-	cfsec = current[1];
-	while (j < 256) {
-	  if (convert) {
-		c = current[j++];
-		if (state == 0) {
-		  if (c == '\t')           // TAB char ?
-			state = -1;
-		  else if (c != 0) {       // ignore NULL
-								   // end of line vs OS...
-#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(APPLE)
-	  		fputc( c, out);
-#endif
-#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__linux__) || defined(__gnu_linux__)
-			if (c == '\r')         // CR ?
-			  fputc( '\n', out);   // add NL
-#endif
-#if defined(__linux__) || defined(__gnu_linux__)
-			else
-	  		  fputc( c, out);
-#endif
-		  }
-		} else {
-		  state = 0;       // number of space to print
-		  while (c-- > 0)
-			fputc( ' ', out);
-		}
-	  } else
-		fputc( current[j++], out);
-	}
-	j = 4;
+
+  nsel = 0;
+  for (k = 0; k < nslot; k++) {
+	if ((file[k].flags & 0x11) != 1 || !filter( k, f))
+	  continue;
+	match = 0;
+	for (i = 0; i < np; i++)
+	  if (fnmatch( upper[i], (char *)file[k].name, 0) == 0) {
+		found[i]++;
+		match = 1;
+	  }
+	if (match)
+	  sel[nsel++] = k;
   }
-  fclose( out);
-  dsktime.tm_hour = 12;
-  dsktime.tm_min = 0;
-  dsktime.tm_sec = 0;
-  dsktime.tm_isdst = 0;
-  dsktime.tm_mday = file[k].day;
-  dsktime.tm_mon = file[k].month-1;
-  dsktime.tm_year = file[k].year-1900;  // Why -1900 ???
-  itime = mktime( &dsktime);
-
-  new_times.actime = time( NULL);
-  new_times.modtime = itime;
-  utime( fname, &new_times);
-
-  if (cftrk != 0 || cfsec != 0 || nb_blk != file[k].length)
-	printf( "Warning! file '%s' may be truncated...\n", fname);
 
-  return 0;
+  for (i = 0; i < np; i++)
+	free( upper[i]);
+  free( upper);
+  return nsel;
+}
+
+// Extract file k from disk image in directory dir (if not NULL)
+
+int extract_file( int k, char *dir, int replace, int convert) {
+  char path[PATH_MAX];
+  int j;
+
+// Only the chain of this file is verified if not done by analyse()
+  if ((check_file( k) & 0x80) != 0)
+	return 5;
+
+  strcpy( fname, (char *)file[k].name);
+  if (convert)
+	for (j = 0; fname[j] != 0; j++)
+      fname[j] = tolower( fname[j]);
+  if (dir != NULL)
+	snprintf( path, sizeof( path), "%s/%s", dir, fname);
+  else
+	strcpy( path, fname);
+
+  switch (write_file( k, path, convert, replace)) {
+	case 3:  return 3;
+	case 4:  return 4;
+	default: return 0;  // a truncated file was told about
+  }
 }
 
 // Program start here
 int main( int argc, char **argv)
 {
   char *term, *getenv( const char *name);
+  static struct option longopts[] = { STATS_OPTION,
+	{ "after", required_argument, 0, 'A' },
+	{ "before", required_argument, 0, 'B' },
+	{ "min-size", required_argument, 0, 'm' },
+	{ "max-size", required_argument, 0, 'M' },
+	{ 0, 0, 0, 0 } };
   int opt;
   char filepath[256];
-  struct stat dsk_stat;
   int retval, done;
   int strict = 0;
   int convert = 0;
   int overwrite = 0;
+  char *dir = NULL;
+  struct Filter f;
+  char *all[2] = { "*", NULL };
   char **infile;
+  int *found;        // files matched by each pattern
+  int *sel;          // files selected
+  int nsel;
   int i;
 
-  while ((opt = getopt( argc, argv, "hvco")) != -1) {
+  memset( &f, 0, sizeof( f));
+  while ((opt = getopt_long( argc, argv, "hvcosd:e:", longopts, NULL)) != -1) {
 	switch (opt) {
 	case 'h':
 	  usage( *argv);
@@ -177,27 +196,67 @@ int main( int argc, char **argv)
 	case 'o':
 	  overwrite = 1;
 	  break;
+	case 's':
+	  strict = 1;
+	  break;
+	case 'd':
+	  dir = optarg;
+	  break;
+	case 'e':
+	  f.ext = optarg;
+	  break;
+	case 'A':
+	case 'B':
+	  if ((i = parse_date( optarg)) < 0) {
+		fprintf( stderr, "Bad date '%s', use YYYY-MM-DD\n", optarg);
+		exit( 2);
+	  }
+	  if (opt == 'A')
+		f.after = i;
+	  else
+		f.before = i;
+	  break;
+	case 'm':
+	  f.minsize = atoi( optarg);
+	  break;
+	case 'M':
+	  f.maxsize = atoi( optarg);
+	  break;
+	case 'S':
+	  stats_init( *argv, optarg);
+	  break;
 	default: /* '?' */
 	  usage( *argv);
 	  exit( 3);
 	}
   }
 
-  if (argc - optind < 2) {
+// Without names, filters select among all files
+  i = f.ext != NULL || f.after || f.before || f.minsize || f.maxsize;
+  if (argc - optind < 2 - i) {
 	fprintf( stderr, "Not enough file names...\n");
 	usage( *argv);
 	exit( 2);
   }
 
 // creating file list
-  infile = (char **) malloc( sizeof( uint8_t *) * (argc - optind));
-  i = 0;
-  while (optind < argc - 1) {
-	infile[i] = argv[optind];
-	optind++;
-	i++;
+  if (argc - optind == 1)
+	infile = all;
+  else {
+	infile = (char **) malloc( sizeof( uint8_t *) * (argc - optind));
+	i = 0;
+	while (optind < argc - 1) {
+	  infile[i] = argv[optind];
+	  optind++;
+	  i++;
+	}
+	infile[i] = NULL;
+  }
+
+  if (dir != NULL && mkdir( dir, 0755) && errno != EEXIST) {
+	perror( dir);
+	exit( 2);
   }
-  infile[i] = NULL;
 
 // If possible, colorize Warnings and Errors
   if (isatty( 1) && (term = getenv( "TERM")) != NULL) {
@@ -213,40 +272,10 @@ int main( int argc, char **argv)
 
 // Checking disk image
   strncpy( filepath, argv[argc-1], 256);
-  if (stat( filepath, &dsk_stat)) {
-	perror( filepath);
-	exit( 2);
-  }
-
-  disk.shortname = strrchr( filepath, '/');
-  if (disk.shortname == NULL)
-	disk.shortname = filepath;
-  else
-	disk.shortname++;
-
-  if ((dsk_stat.st_mode & S_IWUSR) == 0) {
-    fprintf( stderr, "ERROR: %s is not writable!\n", disk.shortname);
-	exit( 2);
-  }
-
-  if ((disk.fd = open( filepath, O_RDONLY)) < 0 ) {
-	perror( filepath);
-	exit( 2);
-  }
-
-  disk.size = dsk_stat.st_size;
-  disk.dsk = malloc( dsk_stat.st_size);
-
-  if (disk.dsk == NULL) {
-    perror( "malloc: ");
-    exit( 3);
-  }
-
-  if (read( disk.fd, disk.dsk, dsk_stat.st_size) != dsk_stat.st_size) {
-	perror( filepath) ;
+// Only the sectors really needed are read from the image: with -s,
+// all of them unless the result of the analyse is in the cache
+  if (load_image( filepath, 1))
 	exit( 3);
-  }
-  close( disk.fd);
 
   // Is it a clean flex image ?
 
@@ -257,7 +286,12 @@ int main( int argc, char **argv)
   if (retval > 1 && retval != 257)
 	return retval;
 
-  if ((retval = analyse( 0)) > 1)
+// Full cross-check only if asked, else the directory is enough
+  if (strict)
+	retval = analyse_cached( filepath, 0);
+  else
+	retval = analyse_dir( 0);
+  if (retval > 1)
 	return retval;
 
   if (verbose) {
@@ -265,18 +299,30 @@ int main( int argc, char **argv)
 	list_files( verbose-1);
   }
 
-  for (i = 0; infile[i] != NULL; i++) {
-	done = extract_file( infile[i], overwrite, convert);
+// All names and patterns resolved in one pass
+  for (i = 0; infile[i] != NULL; i++)
+	;
+  found = malloc( (i + 1) * sizeof( int));
+  sel = malloc( (nslot + 1) * sizeof( int));
+  nsel = select_files( infile, &f, found, sel);
+  for (i = 0; infile[i] != NULL; i++)
+	if (found[i] == 0 && infile != all) {
+	  printf( "%sERROR: File '%s' not found.%s\n", s_err, infile[i], s_norm);
+	  retval |= 1;
+	}
+
+  for (i = 0; i < nsel; i++) {
+	stat_start( PH_EXTRACT);
+	done = extract_file( sel[i], dir, overwrite, convert);
+	stat_stop( PH_EXTRACT);
 	switch (done) {
-	  case 1:  printf( "%sERROR: File '%s' not found.%s\n", s_err, infile[i], s_norm);
-		       break;
-	  case 2:  printf( "%sERROR: File '%s' is marked deleted.%s\n", s_err, infile[i], s_norm);
-		       break;
 	  case 3:  printf( "%sWarning: file '%s' allready present.%s\n", s_warn, fname, s_norm);
 			   printf( "Use -o option to overwrite it\n");
 			   break;
 	  case 4:  printf( "%sERROR: can't create file '%s'.%s\n", s_err, fname, s_norm);
 			   break;
+	  case 5:  printf( "%sERROR: File '%s' is corrupted.%s\n", s_err, file[sel[i]].name, s_norm);
+			   break;
 	  default: if (verbose)
 			   printf( "%sFile '%s' copied%s\n", s_ok, fname, s_norm);
 	  }
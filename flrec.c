@@ -0,0 +1,149 @@
+/* flrec.c -- Read or write one record of a Flex random file
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+int verbose = 0; // more details when verbose increase
+int quiet = 1;   // by default don't give disk infos
+
+char *s_err = "",   // If color is supported => errmsg in red
+     *s_warn = "",  // warnings in yellow
+     *s_norm = "";  // return to normal
+
+void usage( char *cmd) {
+	fprintf( stderr, "Usage: %s [-h] => this help\n", cmd);
+	fprintf( stderr, "       %s [-v] get <disk image> <file> <record#> => record on stdout\n", cmd);
+	fprintf( stderr, "       %s [-v] put <disk image> <file> <record#> => record from stdin\n", cmd);
+    fprintf( stderr, "Options:\n");
+	fprintf( stderr, "   -v => print where the record is\n");
+	fprintf( stderr, "   --stats[=json] => print timings and counters on stderr\n");
+	fprintf( stderr, "Records are numbered from 1 and are %d bytes long\n", RECSIZE);
+}
+
+// Program start here
+int main( int argc, char **argv)
+{
+  char *term, *getenv( const char *name);
+  static struct option longopts[] = { STATS_OPTION, { 0, 0, 0, 0 } };
+  int opt;
+  char *filepath, *name, *end;
+  uint8_t buf[RECSIZE + 1];
+  FILE *out = stdout;
+  int put, rec, k, ibloc, len;
+  int where = 0;
+  int retval;
+
+  while ((opt = getopt_long( argc, argv, "hv", longopts, NULL)) != -1) {
+	switch (opt) {
+	case 'h':
+	  usage( *argv);
+	  exit( 0);
+	  break;
+	case 'v':
+	  where = 1;
+	  break;
+	case 'S':
+	  stats_init( *argv, optarg);
+	  break;
+	default: /* '?' */
+	  usage( *argv);
+	  exit( 3);
+	}
+  }
+
+  if (argc - optind != 4 ||
+      (strcmp( argv[optind], "get") != 0 && strcmp( argv[optind], "put") != 0)) {
+	usage( *argv);
+	exit( 3);
+  }
+  put = strcmp( argv[optind], "put") == 0;
+  filepath = argv[optind+1];
+  name = argv[optind+2];
+  rec = strtol( argv[optind+3], &end, 10);
+  if (*end != 0 || rec < 1) {
+	fprintf( stderr, "Bad record number '%s'\n", argv[optind+3]);
+	exit( 3);
+  }
+
+// If possible, colorize Warnings and Errors
+  if (isatty( 2) && (term = getenv( "TERM")) != NULL) {
+    if (strstr( term, "256color") != NULL) {
+      s_warn = "\e[1;93m";
+      s_err  = "\e[1;91m";
+      s_norm = "\e[0m";
+    }
+  }
+
+// The record is on stdout: messages go to stderr
+  if (!put) {
+	out = fdopen( dup( 1), "wb");
+	dup2( 2, 1);
+  }
+
+// Only the directory, the map and the record are read
+  if (load_image( filepath, 1))
+	exit( 3);
+  if (! isFlex( disk.dsk, disk.nb_sectors))
+	exit( 2);
+  retval = badFlex( 1);
+  if (retval > 1 && retval != 257)
+	return retval;
+  if ((retval = analyse_dir( 0)) > 1)
+	return retval;
+
+  if ((k = find_file( name)) < 0) {
+	printf( "%sERROR: File '%s' not found.%s\n", s_err, name, s_norm);
+	exit( 1);
+  }
+  if ((file[k].flags & 0x02) == 0) {
+	printf( "%sERROR: File '%s' is not a random file.%s\n", s_err, name, s_norm);
+	exit( 1);
+  }
+  if ((ibloc = rec2blk( k, rec)) == -1) {
+	printf( "%sERROR: File '%s' has no record %d (%d records).%s\n",
+	  s_err, name, rec, file[k].length - 2, s_norm);
+	exit( 1);
+  }
+  if (ibloc < 0) {
+	printf( "%sERROR: File '%s': map corrupted.%s\n", s_err, name, s_norm);
+	exit( 2);
+  }
+  if (where)
+	printf( "%s record %d: sector [0x%02X/0x%02X]\n", file[k].name, rec,
+	  blk2trk( ibloc), blk2sec( ibloc));
+
+  if (put) {
+	len = fread( buf, 1, RECSIZE + 1, stdin);
+	if (len > RECSIZE) {
+	  printf( "%sERROR: record longer than %d bytes.%s\n", s_err, RECSIZE, s_norm);
+	  exit( 1);
+	}
+	memset( buf + len, 0, RECSIZE - len);
+	flstat.rbytes += len;
+	stat_start( PH_INSERT);
+	retval = put_record( filepath, k, rec, buf);
+	stat_stop( PH_INSERT);
+  } else {
+	stat_start( PH_EXTRACT);
+	if ((retval = get_record( k, rec, buf)) == 0) {
+	  fwrite( buf, 1, RECSIZE, out);
+	  flstat.wbytes += RECSIZE;
+	}
+	stat_stop( PH_EXTRACT);
+  }
+  return retval;
+}
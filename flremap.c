@@ -0,0 +1,248 @@
+/* flremap.c -- Move the content of a Flex image to another geometry
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+#define MAPENT 84    // triplets in a map sector
+
+// Geometry of the new image, for the track/sector conversions
+
+static struct Geometry *geo;
+
+// Track/sector of bloc ibloc of the new image at p, 0/0 if none
+
+static void put_ts( uint8_t *p, int ibloc) {
+  if (ibloc <= 0) {
+    p[0] = p[1] = 0;
+  } else if (ibloc < geo->track0) {
+    p[0] = 0;
+    p[1] = ibloc + 1;
+  } else {
+    p[0] = (ibloc - geo->track0) / geo->nbsec + 1;
+    p[1] = (ibloc - geo->track0) % geo->nbsec + 1;
+  }
+}
+
+// New bloc of the bloc at track/sector p, -1 if not moved
+
+static int new_blk( int *remap, uint8_t *p) {
+  int ibloc = ts2blk( p[0], p[1]);
+
+  return ibloc > 0 && ibloc < disk.nb_sectors ? remap[ibloc] : -1;
+}
+
+//////////////////////////////////////////////////////////
+// Rewrite the two map sectors of a random file for its //
+// new place: each run is remapped sector by sector and //
+// the runs that became adjacent are merged.            //
+// Return 0 if OK, 2 if the map is not valid            //
+//////////////////////////////////////////////////////////
+
+static int remap_map( int *remap, uint8_t *map0, uint8_t *map1) {
+  uint8_t run[2 * MAPENT][3];
+  uint8_t *map[2], *p;
+  int first = 0, count = 0, t = 0;
+  int ibloc, nbloc, n, i;
+
+  map[0] = map0;
+  map[1] = map1;
+  for (i = 0; i < 2 * MAPENT; i++) {
+    p = map[i / MAPENT] + 4 + 3 * (i % MAPENT);
+    if (p[2] == 0)
+      break;
+    if ((ibloc = ts2blk( p[0], p[1])) < 1)
+      return 2;
+    for (n = 0; n < p[2]; n++) {
+      if (ibloc + n >= disk.nb_sectors || (nbloc = remap[ibloc + n]) < 0)
+        return 2;
+      if (count && nbloc == first + count && count < 255)
+        count++;
+      else {
+        if (count) {
+          put_ts( run[t], first);
+          run[t++][2] = count;
+        }
+        first = nbloc;
+        count = 1;
+      }
+    }
+  }
+  if (count) {
+    put_ts( run[t], first);
+    run[t++][2] = count;
+  }
+  memset( map0 + 4, 0, RECSIZE);
+  memset( map1 + 4, 0, RECSIZE);
+  for (i = 0; i < t; i++)
+    memcpy( map[i / MAPENT] + 4 + 3 * (i % MAPENT), run[i], 3);
+  return 0;
+}
+
+//////////////////////////////////////////////////////////
+// New place of each sector kept in remap[]: directory  //
+// on track 0 as far as it goes, then files in          //
+// directory order, each in a single run, then the free //
+// list while there is room. dir[] gets the directory   //
+// blocs, *nfree the first bloc of the free list.       //
+// Return 0 if OK, 1 if there is not enough room, 2 if  //
+// a chain is corrupted                                 //
+//////////////////////////////////////////////////////////
+
+static int place_sectors( int *remap, int *dir, int *ndir, int *nfree, int nb) {
+  uint8_t *psec;
+  int ibloc, nxt, n, k;
+
+// Boot sectors, SIR and reserved sector keep their place
+  for (k = 0; k < 4 && k < disk.track0l; k++)
+    remap[k] = k;
+  nxt = geo->track0;
+
+  *ndir = 0;
+  for (ibloc = 4; ibloc > 0 && ibloc < disk.nb_sectors && remap[ibloc] < 0;
+       ibloc = get_link( ibloc)) {
+    if (*ndir + 4 < geo->track0)
+      remap[ibloc] = *ndir + 4;
+    else if (nxt < nb)
+      remap[ibloc] = nxt++;
+    else
+      return 1;
+    dir[(*ndir)++] = remap[ibloc];
+  }
+
+  for (k = 0; k < nslot; k++) {
+    if (file[k].flags & 0x10)
+      continue;
+    ibloc = ts2blk( file[k].start_trk, file[k].start_sec);
+    for (n = 0; n < file[k].length && ibloc > 0; n++) {
+      if (ibloc >= disk.nb_sectors || remap[ibloc] >= 0) {
+        printf( "%sERROR: chain of %s is corrupted, use flan -r first%s\n",
+          s_err, file[k].name, s_norm);
+        return 2;
+      }
+      if (nxt == nb)
+        return 1;
+      remap[ibloc] = nxt++;
+      ibloc = get_link( ibloc);
+    }
+  }
+
+// Deleted files are in the free list: it goes at the end of the
+// image, in the same order, after the sectors never used
+  *nfree = nxt;
+  psec = getsec( 2) + 0x1D;
+  for (ibloc = ts2blk( psec[0], psec[1]); ibloc > 0 && ibloc < disk.nb_sectors
+       && remap[ibloc] < 0 && nxt < nb; ibloc = get_link( ibloc))
+    remap[ibloc] = nxt++;
+  for (k = 0; k < disk.nb_sectors && nxt < nb; k++)
+    if (remap[k] >= *nfree)
+      remap[k] += nb - nxt;
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////
+// Build in *out the image of geometry g with the content  //
+// of the analysed image, keeping dates and directory      //
+// order. Each sector moved gets its new place in a        //
+// remapping table, then the links of the sectors, the     //
+// directory entries and the maps of random files are      //
+// translated through it, in one pass in memory. The files //
+// come out contiguous, the free list is one run at the    //
+// end. Return 0 if OK, 1 if the files don't fit in the    //
+// new geometry, 2 if a chain or a map is corrupted        //
+/////////////////////////////////////////////////////////////
+
+int remap_image( struct Geometry *g, uint8_t **out, int *nb_out) {
+  struct Dirsec *ds;
+  struct Entry *e;
+  uint8_t *dsk, *psec;
+  int *remap;        // new bloc of each bloc, -1 if not moved
+  int *dir;          // new blocs of the directory
+  int nb, ndir, nfree, first, i, k;
+  int retval;
+
+  geo = g;
+  nb = g->track0 + (g->nbtrk - 1) * g->nbsec;
+  if ((dsk = calloc( nb, SECSIZE)) == NULL
+      || (remap = malloc( disk.nb_sectors * sizeof( int))) == NULL
+      || (dir = malloc( (disk.nb_sectors + g->track0) * sizeof( int))) == NULL) {
+    perror( "malloc: ");
+    return 3;
+  }
+  for (i = 0; i < disk.nb_sectors; i++)
+    remap[i] = -1;
+  retval = place_sectors( remap, dir, &ndir, &nfree, nb);
+
+// Sectors copied to their new place, links translated (not in boot sectors)
+  for (i = 0; i < disk.nb_sectors && retval == 0; i++)
+    if (remap[i] >= 0) {
+      psec = dsk + remap[i] * SECSIZE;
+      memcpy( psec, getsec( i), SECSIZE);
+      if (i >= 4)
+        put_ts( psec, new_blk( remap, psec));
+      flstat.sectors++;
+    }
+
+// New directory sectors left on track 0 are chained at its end
+  if (retval == 0) {
+    for (i = ndir + 4; i < g->track0; i++)
+      dir[ndir++] = i;
+    for (i = 0; i < ndir; i++)
+      put_ts( dsk + dir[i] * SECSIZE, i + 1 < ndir ? dir[i + 1] : 0);
+
+// Free list: the sectors never used, then those moved, in one run
+    for (i = nfree; i < nb; i++)
+      put_ts( dsk + i * SECSIZE, i + 1 < nb ? i + 1 : 0);
+    psec = dsk + 2 * SECSIZE;
+    put_ts( psec + 0x1D, nfree < nb ? nfree : 0);
+    put_ts( psec + 0x1F, nfree < nb ? nb - 1 : 0);
+    psec[0x21] = (nb - nfree) >> 8;
+    psec[0x22] = (nb - nfree) & 0xFF;
+    psec[0x26] = g->nbtrk - 1;
+    psec[0x27] = g->nbsec;
+  }
+
+// Directory entries, and maps of random files (the second map sector follows the first)
+  for (i = 0; i < ndir && retval == 0; i++) {
+    ds = (struct Dirsec *)(dsk + dir[i] * SECSIZE);
+    for (k = 0; k < 10 && retval == 0; k++) {
+      e = &ds->entry[k];
+      if (e->name[0] == 0)
+        continue;
+      first = new_blk( remap, &e->first_trk);
+      put_ts( &e->first_trk, first);
+      put_ts( &e->last_trk, new_blk( remap, &e->last_trk));
+      if (e->name[0] != 0xFF && e->flags && first > 0
+          && (first + 1 >= nb || remap_map( remap, dsk + first * SECSIZE,
+                                            dsk + (first + 1) * SECSIZE))) {
+        printf( "%sERROR: map of random file %.8s is not valid, use flan -r first%s\n",
+          s_err, e->name, s_norm);
+        retval = 2;
+      }
+    }
+  }
+  geo = NULL;
+
+  free( remap);
+  free( dir);
+  if (retval) {
+    free( dsk);
+    return retval;
+  }
+  *out = dsk;
+  *nb_out = nb;
+  return 0;
+}
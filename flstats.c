@@ -0,0 +1,118 @@
+/* flstats.c -- Instrumentation of the Flex tools
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "flstats.h"
+
+struct Flstat flstat;
+
+static char *phase_name[NB_PHASES] = {
+    "load", "isflex", "badflex", "analyse", "extract", "insert",
+    "delete", "repair", "write", "convert", "format", "remap", "checksum"
+};
+
+static int stats = 0;       // 0: no stats, 1: text, 2: json
+static char *stat_tool;     // name of the tool
+static struct Timer {
+    int depth;              // nested calls are counted once
+    long calls;
+    double start;           // start of the outermost call
+    double total;           // in seconds
+} timer[NB_PHASES];
+
+// Monotonic clock in seconds
+
+static double now( void) {
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void stat_start( int phase) {
+  if (!stats)
+    return;
+  if (timer[phase].depth++ == 0) {
+    timer[phase].calls++;
+    timer[phase].start = now();
+  }
+}
+
+void stat_stop( int phase) {
+  if (!stats || timer[phase].depth == 0)
+    return;
+  if (--timer[phase].depth == 0)
+    timer[phase].total += now() - timer[phase].start;
+}
+
+// Print the statistics on stderr when the tool exits
+
+static void print_stats( void) {
+  int k, first = 1;
+
+  if (stats == 2) {
+    fprintf( stderr, "{\"tool\":\"%s\",\"phases\":{", stat_tool);
+    for (k = 0; k < NB_PHASES; k++) {
+      if (timer[k].calls == 0)
+        continue;
+      fprintf( stderr, "%s\"%s\":{\"calls\":%ld,\"ms\":%.3f}", first ? "" : ",",
+        phase_name[k], timer[k].calls, timer[k].total * 1e3);
+      first = 0;
+    }
+    fprintf( stderr, "},\"sectors\":%llu,\"hops\":%llu,\"bytes_read\":%llu,"
+      "\"bytes_written\":%llu,\"syscalls\":%llu}\n",
+      (unsigned long long)flstat.sectors, (unsigned long long)flstat.hops,
+      (unsigned long long)flstat.rbytes, (unsigned long long)flstat.wbytes,
+      (unsigned long long)flstat.syscalls);
+    return;
+  }
+
+  fprintf( stderr, "%s statistics:\n", stat_tool);
+  fprintf( stderr, "  phase       calls   time (ms)\n");
+  for (k = 0; k < NB_PHASES; k++)
+    if (timer[k].calls)
+      fprintf( stderr, "  %-10s %6ld %11.3f\n", phase_name[k], timer[k].calls,
+        timer[k].total * 1e3);
+  fprintf( stderr, "  sectors visited: %llu\n", (unsigned long long)flstat.sectors);
+  fprintf( stderr, "  chain hops:      %llu\n", (unsigned long long)flstat.hops);
+  fprintf( stderr, "  bytes read:      %llu\n", (unsigned long long)flstat.rbytes);
+  fprintf( stderr, "  bytes written:   %llu\n", (unsigned long long)flstat.wbytes);
+  fprintf( stderr, "  I/O syscalls:    %llu\n", (unsigned long long)flstat.syscalls);
+}
+
+// Enable the statistics: format is NULL or "text" for text, "json" for JSON
+
+void stats_init( char *tool, char *format) {
+  if (format == NULL || strcmp( format, "text") == 0)
+    stats = 1;
+  else if (strcmp( format, "json") == 0)
+    stats = 2;
+  else {
+    fprintf( stderr, "Unknown statistics format '%s', text used\n", format);
+    stats = 1;
+  }
+  if (stat_tool == NULL) {
+    stat_tool = strrchr( tool, '/');
+    stat_tool = stat_tool == NULL ? tool : stat_tool + 1;
+    atexit( print_stats);
+  }
+}
@@ -0,0 +1,55 @@
+/* vim:ts=4
+ * flstats.h -- Instrumentation of the Flex tools
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include <stdint.h>
+
+// Phases timed when --stats is used
+
+enum Phase {
+    PH_LOAD,        // reading the image
+    PH_ISFLEX,      // isFlex()
+    PH_BADFLEX,     // badFlex()
+    PH_ANALYSE,     // analyse(), analyse_dir(), check_file()
+    PH_EXTRACT,     // copy of files from the image
+    PH_INSERT,      // copy of files to the image
+    PH_DELETE,      // deletion of files
+    PH_REPAIR,      // freelist and directory reparation
+    PH_WRITE,       // writing the image back
+    PH_CONVERT,     // text and S19 conversions
+    PH_FORMAT,      // creation of a new image
+    PH_REMAP,       // move to another geometry
+    PH_SUM,         // checksums of sectors and files
+    NB_PHASES
+};
+
+// Counters, always updated (cheap), printed only with --stats
+
+extern struct Flstat {
+    uint64_t sectors;       // sectors visited
+    uint64_t hops;          // chain links followed
+    uint64_t rbytes;        // bytes read
+    uint64_t wbytes;        // bytes written
+    uint64_t syscalls;      // I/O system calls
+} flstat;
+
+// Long option to add to the getopt_long() table of a tool
+#define STATS_OPTION { "stats", optional_argument, 0, 'S' }
+
+extern void stats_init( char *tool, char *format); // --stats[=text|json]
+extern void stat_start( int phase);
+extern void stat_stop( int phase);
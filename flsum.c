@@ -0,0 +1,356 @@
+/* flsum.c -- Checksum manifest of a Flex disk image
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+#define PERLINE 16   // sector CRCs on a line of the manifest
+
+int verbose = 0; // more details when verbose increase
+int quiet = 1;   // by default don't give disk infos
+
+char *s_err = "",   // If color is supported => errmsg in red
+     *s_warn = "",  // warnings in yellow
+     *s_norm = "";  // return to normal
+
+// A file of the manifest
+
+struct Sum {
+  char name[16];
+  uint32_t crc;
+  int length;
+  char date[12];
+  int seen;        // still on the image
+};
+
+static struct Sum *sum;      // files of the manifest, sorted by name
+static int nsum;
+static uint32_t *oldcrc;     // sector CRCs of the manifest, NULL if none
+static int oldnb;            // number of sectors of the manifest
+static uint32_t oldall;      // CRC of the image in the manifest
+static int silent = 0;       // -q: only the return value
+
+void usage( char *cmd) {
+	fprintf( stderr, "Usage: %s [-h] => this help\n", cmd);
+	fprintf( stderr, "       %s [-f] <disk image> => manifest on stdout\n", cmd);
+	fprintf( stderr, "       %s [-q|-v] -c <manifest> <disk image> => verify the image\n", cmd);
+	fprintf( stderr, "       %s --logical <disk images>... => hash of the files of each image\n", cmd);
+    fprintf( stderr, "Options:\n");
+	fprintf( stderr, "   -f => files only, no sector CRCs in the manifest\n");
+	fprintf( stderr, "   -c <manifest> => list the files and sectors that changed\n");
+	fprintf( stderr, "   --logical => same hash for images with the same files\n");
+	fprintf( stderr, "   -q => quiet, only the return value\n");
+	fprintf( stderr, "   -v => print details about the disk image\n");
+	fprintf( stderr, "   --stats[=json] => print timings and counters on stderr\n");
+}
+
+static int cmp_sum( const void *a, const void *b) {
+  return strcmp( ((struct Sum *)a)->name, ((struct Sum *)b)->name);
+}
+
+// Date of file k as in the manifest
+
+static char *file_date( int k, char *date) {
+  snprintf( date, 12, "%d-%02d-%02d", file[k].year, file[k].month, file[k].day);
+  return date;
+}
+
+///////////////////////////////////////////////////////
+// Manifest of the image on stdout: its size and CRC //
+// then a line per file (CRC, length, date, name)    //
+// and unless files_only the CRC of each sector, by  //
+// lines of PERLINE                                  //
+///////////////////////////////////////////////////////
+
+static void manifest( int files_only) {
+  uint32_t *crc, all;
+  char date[12];
+  int ibloc, k;
+
+  crc = malloc( disk.nb_sectors * sizeof( uint32_t));
+  all = sector_crcs( crc);
+  printf( "FLSUM 1 %d %08x\n", disk.nb_sectors, all);
+  for (k = 0; k < nslot; k++)
+    if ((file[k].flags & 0x11) == 1)
+      printf( "F %08x %d %s %s\n", file_crc( k), file[k].length, file_date( k, date), file[k].name);
+  for (ibloc = 0; ibloc < disk.nb_sectors && !files_only; ibloc++) {
+    if (ibloc % PERLINE == 0)
+      printf( "S %d", ibloc);
+    printf( " %08x", crc[ibloc]);
+    if (ibloc % PERLINE == PERLINE - 1 || ibloc == disk.nb_sectors - 1)
+      putchar( '\n');
+  }
+  free( crc);
+}
+
+////////////////////////////////////////////////////
+// Read the manifest in sum[] and oldcrc[]        //
+// Return 0 if OK, 3 if it can't be read or isn't //
+// a manifest                                     //
+////////////////////////////////////////////////////
+
+static int read_manifest( char *path) {
+  FILE *fp;
+  char line[256], *p, *end;
+  unsigned long crc;
+  int max = 64, ibloc;
+
+  if ((fp = fopen( path, "r")) == NULL) {
+    perror( path);
+    return 3;
+  }
+  if (fgets( line, sizeof( line), fp) == NULL
+      || sscanf( line, "FLSUM 1 %d %x", &oldnb, &oldall) != 2 || oldnb < 1) {
+    fprintf( stderr, "%s: not a flsum manifest\n", path);
+    fclose( fp);
+    return 3;
+  }
+  sum = malloc( max * sizeof( struct Sum));
+  nsum = 0;
+  while (fgets( line, sizeof( line), fp) != NULL) {
+    if (line[0] == 'F') {
+      if (nsum == max)
+        sum = realloc( sum, (max *= 2) * sizeof( struct Sum));
+      if (sscanf( line, "F %lx %d %11s %15s", &crc, &sum[nsum].length, sum[nsum].date,
+                  sum[nsum].name) != 4)
+        break;
+      sum[nsum].crc = crc;
+      sum[nsum++].seen = 0;
+    } else if (line[0] == 'S') {
+      if (oldcrc == NULL)
+        oldcrc = calloc( oldnb, sizeof( uint32_t));
+      ibloc = strtol( line + 1, &p, 10);
+      for (crc = strtoul( p, &end, 16); end != p && ibloc >= 0 && ibloc < oldnb;
+           crc = strtoul( p, &end, 16)) {
+        oldcrc[ibloc++] = crc;
+        p = end;
+      }
+    } else
+      break;
+  }
+  if (!feof( fp)) {
+    fprintf( stderr, "%s: bad line '%.40s'\n", path, line);
+    fclose( fp);
+    return 3;
+  }
+  fclose( fp);
+  qsort( sum, nsum, sizeof( struct Sum), cmp_sum);
+  return 0;
+}
+
+// What uses bloc ibloc of the analysed image
+
+static char *owner( int ibloc) {
+  if (ibloc < 3)
+    return ibloc < 2 ? "boot" : "SIR";
+  if (tabsec[ibloc] > 0)
+    return (char *)file[tabsec[ibloc] - 1].name;
+  if (tabsec[ibloc] == 0)
+    return "directory";
+  if (tabsec[ibloc] == -1)
+    return "free";
+  return "unused";
+}
+
+///////////////////////////////////////////////////////////
+// Compare the image with the manifest. The CRC of all   //
+// sectors is computed in one pass: if it is the one of  //
+// the manifest, nothing else is done. Otherwise the     //
+// sectors that changed are listed, and only the files   //
+// using one of them (or whose entry changed) have their //
+// CRC computed again. Without sector CRCs in the        //
+// manifest, or if the size changed, all the files are.  //
+// Return 0 if the image didn't change, 1 if it did, 2   //
+// or 3 if it can't be analysed                          //
+///////////////////////////////////////////////////////////
+
+static int verify( char *filepath) {
+  struct Sum key, *s;
+  uint32_t *crc, all;
+  uint8_t *touched;
+  char date[12];
+  int ibloc, k, retval;
+
+  crc = malloc( disk.nb_sectors * sizeof( uint32_t));
+  all = sector_crcs( crc);
+  if (all == oldall && disk.nb_sectors == oldnb) {
+    free( crc);
+    return 0;
+  }
+  if ((retval = analyse_cached( filepath, 0)) > 1) {
+    free( crc);
+    return retval;
+  }
+
+  touched = calloc( nslot + 1, 1);
+  if (oldcrc == NULL || disk.nb_sectors != oldnb) {
+    if (!silent && disk.nb_sectors != oldnb)
+      printf( "Image of %d sectors instead of %d\n", disk.nb_sectors, oldnb);
+    memset( touched, 1, nslot + 1);
+  } else {
+    for (ibloc = 0; ibloc < disk.nb_sectors; ibloc++)
+      if (crc[ibloc] != oldcrc[ibloc]) {
+        if (tabsec[ibloc] > 0)
+          touched[tabsec[ibloc] - 1] = 1;
+        if (!silent)
+          printf( "[%02X/%02X] changed (%s)\n", blk2trk( ibloc), blk2sec( ibloc), owner( ibloc));
+      }
+  }
+  free( crc);
+
+  for (k = 0; k < nslot; k++) {
+    if ((file[k].flags & 0x11) != 1)
+      continue;
+    strcpy( key.name, (char *)file[k].name);
+    if ((s = bsearch( &key, sum, nsum, sizeof( struct Sum), cmp_sum)) == NULL) {
+      if (!silent)
+        printf( "%s: new\n", file[k].name);
+      continue;
+    }
+    s->seen = 1;
+    if (s->length != file[k].length || strcmp( s->date, file_date( k, date)) != 0
+        || (touched[k] && file_crc( k) != s->crc)) {
+      if (!silent)
+        printf( "%s: changed\n", file[k].name);
+    }
+  }
+  for (k = 0; k < nsum; k++)
+    if (!sum[k].seen && !silent)
+      printf( "%s: removed\n", sum[k].name);
+  free( touched);
+  return 1;
+}
+
+////////////////////////////////////////////////////
+// Print the logical hash of the files of image   //
+// filepath, the same for images whose files are  //
+// the same, wherever they are.                   //
+// Return 0 if OK, 2 if the image is not a Flex   //
+// image or is damaged, 3 if it can't be read     //
+////////////////////////////////////////////////////
+
+static int logical( char *filepath) {
+  int retval;
+
+  if (load_image( filepath, 0))
+    return 3;
+  if (! isFlex( disk.dsk, disk.nb_sectors)) {
+    close_image();
+    return 2;
+  }
+  retval = badFlex( 1);
+  if ((retval <= 1 || retval == 257) && (retval = analyse_cached( filepath, 0)) <= 1) {
+    printf( "%016llx  %s\n", (unsigned long long)logical_hash(), filepath);
+    retval = 0;
+  }
+  close_image();
+  return retval;
+}
+
+// Program start here
+int main( int argc, char **argv)
+{
+  char *term, *getenv( const char *name);
+  static struct option longopts[] = { STATS_OPTION,
+	{ "logical", no_argument, 0, 'L' },
+	{ 0, 0, 0, 0 } };
+  int opt;
+  char *filepath, *check = NULL;
+  int files_only = 0, logic = 0;
+  int retval, i, r;
+
+  while ((opt = getopt_long( argc, argv, "hvqfc:", longopts, NULL)) != -1) {
+	switch (opt) {
+	case 'h':
+	  usage( *argv);
+	  exit( 0);
+	  break;
+	case 'v':
+	  verbose = 1;
+	  quiet = 0;
+	  break;
+	case 'q':
+	  silent = 1;
+	  break;
+	case 'f':
+	  files_only = 1;
+	  break;
+	case 'c':
+	  check = optarg;
+	  break;
+	case 'L':
+	  logic = 1;
+	  break;
+	case 'S':
+	  stats_init( *argv, optarg);
+	  break;
+	default: /* '?' */
+	  usage( *argv);
+	  exit( 3);
+	}
+  }
+
+  if (argc - optind < 1 || (argc - optind > 1 && !logic) || (logic && check != NULL)) {
+	usage( *argv);
+	exit( 3);
+  }
+  filepath = argv[optind];
+
+// If possible, colorize Warnings and Errors
+  if (isatty( 1) && (term = getenv( "TERM")) != NULL) {
+    if (strstr( term, "256color") != NULL) {
+      s_warn = "\e[1;93m";
+      s_err  = "\e[1;91m";
+      s_norm = "\e[0m";
+    }
+  }
+
+// Images are read one after the other
+  disk.readonly = 1;
+  if (logic) {
+	retval = 0;
+	stat_start( PH_SUM);
+	for (i = optind; i < argc; i++)
+	  if ((r = logical( argv[i])) > retval)
+		retval = r;
+	stat_stop( PH_SUM);
+	return retval;
+  }
+
+  if (check != NULL && read_manifest( check))
+	exit( 3);
+  if (load_image( filepath, 0))
+	exit( 3);
+  if (! isFlex( disk.dsk, disk.nb_sectors))
+	exit( 2);
+  retval = badFlex( 1);
+  if (retval > 1 && retval != 257)
+	return retval;
+
+  stat_start( PH_SUM);
+  if (check == NULL) {
+	if ((retval = analyse_cached( filepath, 0)) > 1)
+	  return retval;
+	manifest( files_only);
+	retval = 0;
+  } else {
+	retval = verify( filepath);
+	if (!silent && verbose)
+	  printf( "%s: %s\n", filepath, retval ? "changed" : "OK");
+  }
+  stat_stop( PH_SUM);
+  return retval;
+}
@@ -0,0 +1,235 @@
+/* flundel.c -- Restore deleted files in place in a Flex disk image
+   Copyright (C) 2026 Michel Wurtz - mjwurtz@gmail.com
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include "dskflex.h"
+
+int verbose = 0; // more details when verbose increase
+int quiet = 1;   // by default don't give disk infos
+
+char *s_err = "",   // If color is supported => errmsg in red
+     *s_warn = "",  // warnings in yellow
+     *s_norm = "";  // return to normal
+
+static uint8_t *dirty;   // sectors to write back
+
+void usage( char *cmd) {
+	fprintf( stderr, "Usage: %s [-h] => this help\n", cmd);
+	fprintf( stderr, "       %s [-v] <files>... <disk image>\n", cmd);
+	fprintf( stderr, "       %s [-v] -e <id> <file> <disk image>\n", cmd);
+    fprintf( stderr, "Options:\n");
+	fprintf( stderr, "   -e <id> => restore directory entry id (as listed by flls -l)\n");
+	fprintf( stderr, "   -v => print details about the disk image\n");
+	fprintf( stderr, "   --stats[=json] => print timings and counters on stderr\n");
+	fprintf( stderr, "The first letter of a deleted file is lost, give the whole name\n");
+}
+
+// Link of a free sector, or head of the free list if ibloc is 0
+
+static void relink( int ibloc, int next) {
+  if (ibloc) {
+    set_link( ibloc, next);
+    dirty[ibloc] = 1;
+  } else {
+    disk.dsk[0x21d] = next ? blk2trk( next) : 0;
+    disk.dsk[0x21e] = next ? blk2sec( next) : 0;
+  }
+}
+
+////////////////////////////////////////////////////////////
+// Deleted entry matching name, its first letter apart,   //
+// entry id if not 0. Return its index, -1 if none can be //
+// restored, -2 if several can                            //
+////////////////////////////////////////////////////////////
+
+static int find_deleted( char *name, int id) {
+  char fname[16];
+  int k, found = -1;
+
+  if (strlen( name) > 12 || !isalpha( name[0]))
+    return -1;
+  for (k = 0; name[k]; k++)
+    fname[k] = toupper( name[k]);
+  fname[k] = 0;
+  for (k = 0; k < nslot; k++)
+    if ((file[k].flags & 0x30) == 0x30 && strcmp( (char *)file[k].name + 1, fname + 1) == 0
+        && (id == 0 || id == k + 1)) {
+      if (found >= 0)
+        return -2;
+      found = k;
+    }
+  return found;
+}
+
+/////////////////////////////////////////////////////////////
+// Restore deleted file k as name: its sectors are taken   //
+// out of the free list in one walk of it, wherever they   //
+// are, then its last sector ends the chain and the entry  //
+// gets back its first letter. Only the links that change, //
+// the SIR and the directory sector are marked to be       //
+// written                                                 //
+/////////////////////////////////////////////////////////////
+
+static void undelete( int k, char *name) {
+  uint8_t *in;        // sectors of the file
+  int ibloc, next, prev, skipped, removed, n, last;
+
+  in = calloc( disk.nb_sectors, 1);
+  last = ibloc = ts2blk( file[k].start_trk, file[k].start_sec);
+  for (n = 0; n < file[k].length && ibloc > 0; n++) {
+    in[ibloc] = 1;
+    last = ibloc;
+    ibloc = get_link( ibloc);
+  }
+
+  prev = skipped = removed = 0;
+  ibloc = ts2blk( disk.dsk[0x21d], disk.dsk[0x21e]);
+  for (n = 0; ibloc > 0 && n < disk.nb_sectors; n++) {
+    next = get_link( ibloc);
+    if (in[ibloc]) {
+      removed++;
+      skipped = 1;
+    } else {
+      if (skipped)
+        relink( prev, ibloc);
+      prev = ibloc;
+      skipped = 0;
+    }
+    ibloc = next;
+  }
+  if (skipped)
+    relink( prev, 0);
+  disk.dsk[0x21f] = prev ? blk2trk( prev) : 0;
+  disk.dsk[0x220] = prev ? blk2sec( prev) : 0;
+  disk.freesec -= removed;
+  disk.dsk[0x221] = disk.freesec >> 8;
+  disk.dsk[0x222] = disk.freesec & 0xFF;
+  dirty[2] = 1;
+
+  if (get_link( last) != 0) {
+    set_link( last, 0);
+    dirty[last] = 1;
+  }
+  for (n = 0; n < disk.nb_sectors; n++)
+    if (in[n])
+      tabsec[n] = k + 1;
+  free( in);
+
+  file[k].pos[0] = toupper( name[0]);
+  file[k].name[0] = toupper( name[0]);
+  file[k].flags &= ~0x30;
+  dirty[(file[k].pos - disk.dsk) / SECSIZE] = 1;
+  nfile++;
+  ndel--;
+}
+
+// Program start here
+int main( int argc, char **argv)
+{
+  char *term, *getenv( const char *name);
+  static struct option longopts[] = { STATS_OPTION, { 0, 0, 0, 0 } };
+  int opt;
+  char *filepath;
+  int retval, done = 0;
+  int id = 0;
+  int i, k, n;
+
+  while ((opt = getopt_long( argc, argv, "hve:", longopts, NULL)) != -1) {
+	switch (opt) {
+	case 'h':
+	  usage( *argv);
+	  exit( 0);
+	  break;
+	case 'v':
+	  verbose = 1;
+	  quiet = 0;
+	  break;
+	case 'e':
+	  id = atoi( optarg);
+	  break;
+	case 'S':
+	  stats_init( *argv, optarg);
+	  break;
+	default: /* '?' */
+	  usage( *argv);
+	  exit( 3);
+	}
+  }
+
+  if (argc - optind < 2) {
+	fprintf( stderr, "Not enough file names...\n");
+	usage( *argv);
+	exit( 3);
+  }
+  if (id && argc - optind != 2) {
+	fprintf( stderr, "Only one file name with -e\n");
+	exit( 3);
+  }
+  filepath = argv[argc-1];
+
+// If possible, colorize Warnings and Errors
+  if (isatty( 1) && (term = getenv( "TERM")) != NULL) {
+    if (strstr( term, "256color") != NULL) {
+      s_warn = "\e[1;93m";
+      s_err  = "\e[1;91m";
+      s_norm = "\e[0m";
+    }
+  }
+
+  if (load_image( filepath, 0))
+	exit( 3);
+  if (! isFlex( disk.dsk, disk.nb_sectors))
+	exit( 2);
+  retval = badFlex( 1);
+  if (retval > 1 && retval != 257)
+	return retval;
+  if ((retval = analyse_cached( filepath, 0)) > 1) {
+	printf( "%sERROR: image damaged, use flan -r first%s\n", s_err, s_norm);
+	return retval;
+  }
+
+  dirty = calloc( disk.nb_sectors, 1);
+  stat_start( PH_INSERT);
+  for (i = optind; i < argc - 1; i++) {
+	if (find_file( argv[i]) >= 0) {
+	  printf( "%sERROR: File '%s' exists.%s\n", s_err, argv[i], s_norm);
+	  retval |= 1;
+	} else if ((k = find_deleted( argv[i], id)) == -2) {
+	  printf( "%sERROR: several deleted files match '%s', use -e.%s\n", s_err, argv[i], s_norm);
+	  retval |= 1;
+	} else if (k < 0) {
+	  printf( "%sERROR: no deleted file '%s' can be restored.%s\n", s_err, argv[i], s_norm);
+	  retval |= 1;
+	} else {
+	  undelete( k, argv[i]);
+	  if (verbose)
+		printf( "File '%s' restored\n", file[k].name);
+	  done++;
+	}
+  }
+  stat_stop( PH_INSERT);
+
+// Only the sectors changed are written, by runs
+  for (i = 0; i < disk.nb_sectors && done; i = k) {
+	for (k = i; k < disk.nb_sectors && dirty[k]; k++)
+	  ;
+	if ((n = k - i) > 0 && write_sectors( filepath, i, n))
+	  return 3;
+	if (n == 0)
+	  k++;
+  }
+  return retval;
+}
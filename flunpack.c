@@ -19,45 +19,60 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <getopt.h>
+#include "flstats.h"
+#include "flconv.h"
 
 int main ( int argc, char *argv[]) {
 
 	FILE *input, *output;
-	int chin;		// readed char
-	int flag = 0;	// space compression ?
-	int nspace;		// number of spaces
+	uint8_t inbuf[4096], *outbuf;
+	size_t len;
+	struct Textconv tc;	// conversion state
+	int opt;		// opt value
+	static struct option longopts[] = { STATS_OPTION, { 0, 0, 0, 0 } };
 
-	if (argc > 1) {
-		if ((input = fopen( argv[1], "r")) == NULL) {
-			perror( argv[1]);
+	while ((opt = getopt_long( argc, argv, "", longopts, NULL)) != -1) {
+		switch (opt) {
+		case 'S':
+			stats_init( *argv, optarg);
+			break;
+		default:
+			fprintf( stderr, "Usage: %s [--stats[=json]] [input_file [output_file]]\n", argv[0]);
+			exit( 1);
+		}
+	}
+
+	if (optind < argc) {
+		if ((input = fopen( argv[optind], "r")) == NULL) {
+			perror( argv[optind]);
 			fprintf( stderr, "Usage: %s [input_file]\n", argv[0]);
 			exit( 1);
 		}
+		optind++;
 	} else
 		input = stdin;
-	if (argc > 2) {
-		if ((output = fopen( argv[2], "w")) == NULL) {
-			perror( argv[2]);
+	if (optind < argc) {
+		if ((output = fopen( argv[optind], "w")) == NULL) {
+			perror( argv[optind]);
 			fprintf( stderr, "Usage: %s [input_file]\n", argv[0]);
 			exit( 1);
 		}
 	} else
 		output = stdout;
 
-	while ((chin = fgetc( input)) != EOF) {
-		if (flag == 1) {
-			nspace = chin;			// number of spaces follows TAB
-			while (nspace--)
-				fputc( ' ', output);
-			flag = 0;
-			continue;
-		}
-		if (chin == '\t')			// TAB => prepare for multiple spaces
-			flag = 1;
-		else if (chin == '\r')
-			fputc( '\n', output);	// CR to LF conversion
-		else if (chin != 0)
-			fputc( chin, output);	// do nothing for null in file
+	stat_start( PH_CONVERT);
+	text_init( &tc, 8);
+	if ((outbuf = malloc( UNPACK_MAX( sizeof( inbuf)))) == NULL) {
+		perror( argv[0]);
+		exit( 1);
+	}
+	while ((len = fread( inbuf, 1, sizeof( inbuf), input)) > 0) {
+		flstat.rbytes += len;
+		len = unpack_text( &tc, inbuf, len, outbuf);
+		fwrite( outbuf, 1, len, output);
+		flstat.wbytes += len;
 	}
+	stat_stop( PH_CONVERT);
 	exit( 0);
 }
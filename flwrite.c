@@ -20,6 +20,7 @@
 int verbose = 0; // more details when verbose increase
 int quiet = 1;   // by default don't give disk infos
 char ffname[16]; // Flex 'name.ext' used (Upper case name)
+static uint8_t *dirty;   // sectors changed by an append, to write back
 
 char *s_err,     // If color is supported => errmsg in red
      *s_warn,    // warnings in yellow
@@ -29,86 +30,122 @@ char *s_err,     // If color is supported => errmsg in red
 void usage( char *cmd) {
 	fprintf( stderr, "Usage: %s [-h] => this help\n", cmd);
 	fprintf( stderr, "       %s [-d] [-f] [-o] [-v] <infile>... <disk image>\n", cmd);
+	fprintf( stderr, "       %s [-f] [-o] [-v] [--append] --name <flex name> <infile>|- <disk image>\n", cmd);
+	fprintf( stderr, "       %s [-f] [-v] --append <infile>... <disk image>\n", cmd);
+	fprintf( stderr, "       %s [-f] [-o] [-v] --random-create <name> --records <n> <disk image>\n", cmd);
     fprintf( stderr, "Options:\n");
-	fprintf( stderr, "   -d => delete infile from disk image, instead of copy them to\n");
+	fprintf( stderr, "   -d => delete infile (or files matching a pattern like '*.BAK') from disk image\n");
 	fprintf( stderr, "   -f => if disk image geometry is unusual, accept it and don't quit\n");
 	fprintf( stderr, "   -o => if a file exists on image, don't ignore it but replace it\n");
 	fprintf( stderr, "   -v => print a listing of infile copied/deleted\n");
+	fprintf( stderr, "   --name <flex name> => name of the file on image, '-' reads stdin\n");
+	fprintf( stderr, "   --append => add infile at the end of the Flex file of the same name\n");
+	fprintf( stderr, "   --random-create <name> => create an empty random file of\n");
+	fprintf( stderr, "      --records <n> records, in one run of sectors if possible\n");
+	fprintf( stderr, "   --stats[=json] => print timings and counters on stderr\n");
 }
 
 // Modify the content of the disk loaded
 
-// Delete file from disk image
-
-int delete_file( char *name) {
+///////////////////////////////////////////////////////////
+// Delete all the files matching one of the patterns     //
+// (shell globs like *.BAK, case insensitive) in one     //
+// directory pass. Their chains are linked together and  //
+// added to the freelist at once: the SIR is updated     //
+// once. found[i] is the number of files matched by      //
+// patterns[i]. Return the number of files deleted       //
+///////////////////////////////////////////////////////////
 
+int delete_files( char **patterns, int *found) {
   struct Entry *entry;
-  uint8_t *current_sector;
-  int k;
-  char fname[16];
+  char **upper;      // patterns in upper case
+  int np, ndone, total, first, last, ibloc;
+  int i, j, k, match;
 
-// delete file from disk image
+  for (np = 0; patterns[np] != NULL; np++)
+	;
+  upper = malloc( np * sizeof( char *));
+  for (i = 0; i < np; i++) {
+	upper[i] = strdup( patterns[i]);
+	for (j = 0; upper[i][j] != 0; j++)
+	  upper[i][j] = toupper( upper[i][j]);
+	found[i] = 0;
+  }
 
-  if (strlen( name) > 12)
-    return 1;
-  for (k = 0; k < strlen( name); k++)
-	fname[k] = toupper( name[k]);
-  fname[k] = 0;
+  ndone = total = first = last = 0;
+  for (k = 0; k < nslot; k++) {
+	if ((file[k].flags & 0x11) != 1)
+	  continue;
+	match = 0;
+	for (i = 0; i < np; i++)
+	  if (fnmatch( upper[i], (char *)file[k].name, 0) == 0) {
+		found[i]++;
+		match = 1;
+	  }
+	if (!match)
+	  continue;
+	if (verbose)
+	  printf( "%sFile '%s' deleted%s\n", s_ok, file[k].name, s_norm);
 
-  k = 0;
-  while (strcmp( file[k].name, fname) != 0 && k < nslot) {
-	 k++;
+	// First char of name becomes $FF
+	entry = (struct Entry *)file[k].pos;
+	entry->name[0] = 0xFF;
+	file[k].flags |= 0x10;
+	file[k].name[0] = '?';
+	nfile--;
+	ndel++;
+	ndone++;
+
+	// Chain linked after the previous one
+	if ((ibloc = ts2blk( file[k].start_trk, file[k].start_sec)) < 1)
+	  continue;
+	if (first == 0)
+	  first = ibloc;
+	else
+	  set_link( last, ibloc);
+	last = ts2blk( file[k].end_trk, file[k].end_sec);
+	total += file[k].length;
   }
-  if (k == nslot)
-    return 1;
-  // First char of name becomes $FF
-  entry = (struct Entry *)file[k].pos;
-  entry->name[0] = 0xFF;
-  file[k].flags |= 0x10;
-  file[k].name[0] = '?';
-  nfile--;
-  ndel++;
-  // Number of free sectors += size of file
-  disk.freesec += file[k].length;
-  disk.dsk[0x221] = (uint8_t) (disk.freesec / 256);
-  disk.dsk[0x222] = (uint8_t) (disk.freesec % 256);
-  // End of Freesector list point to start of file
-  current_sector = ts2pos( disk.dsk[0x21f], disk.dsk[0x220]);
-  current_sector[0] = file[k].start_trk;
-  current_sector[1] = file[k].start_sec;
-  // New end of Freesector list
-  disk.dsk[0x21f] = file[k].end_trk;
-  disk.dsk[0x220] = file[k].end_sec;
-
-  return 0;
+
+  // All the chains at the end of the freelist
+  if (first)
+	free_sectors( first, last, total);
+
+  for (i = 0; i < np; i++)
+	free( upper[i]);
+  free( upper);
+  return ndone;
 }
 
-// Add file to disk image
+// Delete one file from disk image
+// Return 0 if done, 1 if not found
 
-int insert_file( char *name, int replace) {
-  struct Entry *entry; // directory entry
-  int retval;        // Return value
-  int i, j, k;       // loo indexes
+int delete_file( char *name) {
+  char *patterns[2];
+  int found;
 
-  char *fname;       // Unix file name
-  char filename[10]; // Flex file name
-  char extension[4]; // Flex file extension
-  char *ext;
-  FILE *f_in;        // Original Unix file name
-  int fsize;         // Size of file
-  int random;        // Copy random file ?
-  int nbf;           // Number of blocs needed to copy
-  char magic[13];    // fila start with "" if random
-  uint8_t cfsec, cftrk;
-  uint8_t *base;
-  int ibloc;
+  if (strlen( name) > 12)
+    return 1;
+  patterns[0] = name;
+  patterns[1] = NULL;
+  return delete_files( patterns, &found) == 0;
+}
 
-  struct stat inbuf; // unix file metadata
+///////////////////////////////////////////////////////////
+// Flex name of a Unix file: 8+3, start by a letter,     //
+// then only [-_A-Z0-9]. ffname is set to 'NAME.EXT'     //
+// Return 0 if the name is unchanged, else 1 if the      //
+// first char was replaced, 2 if other chars were, 4 if  //
+// the name and 8 if the extension were truncated        //
+///////////////////////////////////////////////////////////
 
-  struct tm *ftime;
-  uint8_t *current_sector;
+static int flex_name( char *name, char *filename, char *extension) {
+  char *fname;       // Unix file name
+  char *ext;
+  int retval;
+  int i;
 
-// Flex name must be 8+3, start by a letter, then only [-_A-Z0-9]
+  memset( filename, 0, 10);
   fname = strrchr( name, '/');
   if (fname == NULL)
 	fname = name;
@@ -160,51 +197,28 @@ int insert_file( char *name, int replace) {
 	  retval |= 8;
 	extension[i] = 0;
   }
-// Existing file of same name ?
   strcpy( ffname, filename);
   strcat( ffname, ".");
   strcat( ffname, extension);
-  k = 0;
-  while (strcmp( file[k].name, ffname) != 0 && k < nslot)
-	 k++;
-  if (k != nslot)
-	if (replace == 0)
-      return 0x20;
-	else if (delete_file( fname))
-	  return 0x30;
-// Is a directory entry available ?
-  if (nfile >= nslot)
-	return 0x10;
+  return retval;
+}
 
-// Verify free space
-  if (stat( name, &inbuf) < 0) {
-	if (verbose)
-	  perror( name);
-	return 0x40;
-  }
+// Index of the file named ffname, or nslot if none
 
-  if ((inbuf.st_mode & S_IFMT) != S_IFREG)
-	return 0x50;
+static int find_ffname( void) {
+  int k = 0;
 
-  if ((f_in = fopen( name, "r")) == NULL) {
-	if (verbose)
-	  perror( name);
-	return 0x40;
-  }
-
-  // Test if a file saved by fldump or flread is random
-  
-  nbf = inbuf.st_size / 252;
-  if (fsize % 252 != 0) {
-	nbf++;
-	retval |= 8;
-	if (verbose > 1)
-	  printf( "Padding file '%s' with '0's.\n", name);
-  }
-  if (disk.freesec < nbf)
-	return 0x60;
+  while (k < nslot && strcmp( file[k].name, ffname) != 0)
+	 k++;
+  return k;
+}
 
 // Find first free directory entry, or first deleted entry
+// Return nslot if none
+
+static int free_slot( void) {
+  int k;
+
   if (ndel + nfile == nslot)
  	k = nslot;
   else
@@ -216,27 +230,36 @@ int insert_file( char *name, int replace) {
 	while (k < nslot && (file[k].flags & 0x10) != 0x10)
 	  k++;
   }
-  if (k == nslot)
-	return 0x10;
-  if ((file[k].flags & 0x10) != 0x10)
-	ndel--;
+  return k;
+}
 
-// Update directory entry found and Sir
+////////////////////////////////////////////////////////
+// Fill directory entry k for a new file of nbf blocs //
+// named filename.extension, dated mtime              //
+// First and last sectors are left to the caller      //
+////////////////////////////////////////////////////////
+
+static struct Entry *new_entry( int k, char *filename, char *extension,
+                                int nbf, int random, time_t mtime) {
+  struct Entry *entry;
+  struct tm *ftime;
+  int i;
+
+  if ((file[k].flags & 0x10) == 0x10)
+	ndel--;
   nfile++;
   entry = (struct Entry *)file[k].pos;
+  memset( entry, 0, sizeof( struct Entry));
 
-  disk.freesec -= nbf;
-  disk.dsk[0x221] = (uint8_t) (disk.freesec / 256);
-  disk.dsk[0x222] = (uint8_t) (disk.freesec % 256);
-
-// Fill name, length, start sector (first of free list), and date
+// Fill name, length and date
   file[k].length = nbf;
   entry->length[1] = nbf & 0xFF;
-  if (nbf > 256)
-	entry->length[0] = (uint8_t) (nbf / 256);
+  entry->length[0] = (uint8_t) (nbf / 256);
 
   strcpy( file[k].name, ffname);
-  file[k].flags = 1;
+  file[k].flags = random ? 3 : 1;
+  file[k].random = random;
+  entry->flags = random ? 2 : 0;
 
   strcpy (entry->name, filename);
   for (i = strlen( filename); i < 8; i++)
@@ -245,106 +268,694 @@ int insert_file( char *name, int replace) {
   for (i = strlen( extension); i < 3; i++)
 	entry->ext[i] = 0;
 
-  ftime = localtime( &inbuf.st_mtime);
+  ftime = localtime( &mtime);
   file[k].day = (uint8_t) ftime->tm_mday;
   entry->f_day = file[k].day;
   file[k].month = (uint8_t) ftime->tm_mon + 1;
   entry->f_month = file[k].month;
   file[k].year = (uint8_t) ftime->tm_year;
   entry->f_year = (uint8_t)(file[k].year & 0xFF);
+  return entry;
+}
 
-  cftrk = disk.dsk[0x21d];
-  cfsec = disk.dsk[0x21e];
-  file[k].start_trk = cftrk;
-  file[k].start_sec = cfsec;
-  entry->first_trk = cftrk;
-  entry->first_sec = cfsec;
-  current_sector = ts2pos( cftrk, cfsec);
+/////////////////////////////////////////////////////////
+// Read the whole file f_in in memory, but no more     //
+// than the free sectors hold plus one sector: its     //
+// size needn't be known                               //
+// Return the data (*len bytes), NULL if no memory     //
+/////////////////////////////////////////////////////////
 
-// Copy sectors.
+static uint8_t *read_input( FILE *f_in, long *len) {
+  uint8_t *data;
+  long max, n;
+
+  max = (long)(disk.freesec + 1) * 252;
+  if ((data = malloc( max)) == NULL)
+	return NULL;
+  for (*len = 0; *len < max && (n = fread( data + *len, 1, max - *len, f_in)) > 0; *len += n)
+	;
+  flstat.rbytes += *len;
+  return data;
+}
+
+/////////////////////////////////////////////////////////
+// Add a file to disk image. It is read whole first,   //
+// then put in sectors taken from the head of the      //
+// freelist. "-" is stdin                              //
+// The Flex name is dest, or made from name if NULL    //
+// Return a code for report()                          //
+/////////////////////////////////////////////////////////
+
+int insert_file( char *name, char *dest, int replace) {
+  struct Entry *entry; // directory entry
+  int retval;        // Return value
+  int k;             // directory entry
+  int old;           // entry of the file replaced
+
+  char filename[10]; // Flex file name
+  char extension[4]; // Flex file extension
+  FILE *f_in;        // Original Unix file
+  int random;        // Copy random file ?
+  int nbf;           // Number of blocs copied
+  int i, n;
+  int first, last, ibloc;
+  uint8_t *data;     // content of the Unix file
+  long len;
+  time_t mtime;
+
+  struct stat inbuf; // unix file metadata
+
+  uint8_t *current_sector;
+
+  retval = flex_name( dest != NULL ? dest : name, filename, extension);
+
+// Existing file of same name ? It is deleted once the new one is read,
+// so that it is kept if the new one doesn't fit
+  old = find_ffname();
+  if (old != nslot && replace == 0)
+	return 0x20;
+
+  if (strcmp( name, "-") == 0) {
+	f_in = stdin;
+	mtime = time( NULL);
+  } else {
+	if (stat( name, &inbuf) < 0) {
+	  if (verbose)
+		perror( name);
+	  return 0x40;
+	}
+	if ((inbuf.st_mode & S_IFMT) == S_IFDIR)  // pipes and devices are read as well
+	  return 0x50;
+	if ((f_in = fopen( name, "r")) == NULL) {
+	  if (verbose)
+		perror( name);
+	  return 0x40;
+	}
+	mtime = inbuf.st_mtime;
+// A regular file that only fits in the place of the old one
+	nbf = (inbuf.st_size + 251) / 252;
+	if (old != nslot && (inbuf.st_mode & S_IFMT) == S_IFREG
+	    && nbf > disk.freesec && nbf <= disk.freesec + file[old].length) {
+	  if (delete_file( ffname)) {
+		fclose( f_in);
+		return 0x30;
+	  }
+	  old = nslot;
+	}
+  }
+// Is a directory entry available ? The one of the old file is reused
+  if (old != nslot)
+	k = old;
+  else if ((k = free_slot()) == nslot && (k = grow_dir()) < 0) {
+	if (f_in != stdin)
+	  fclose( f_in);
+	return 0x10;
+  }
+
+// Read the whole file first: the free sectors are taken from the
+// freelist and written only once it is known to fit, so that a file
+// too big leaves them untouched (with the deleted files they may hold)
+  data = read_input( f_in, &len);
+  if (f_in != stdin)
+	fclose( f_in);
+  if (data == NULL) {
+	perror( "malloc: ");
+	return 0x40;
+  }
+  nbf = len > 0 ? (len + 251) / 252 : 1;  // An empty file still needs a sector
+// Test if a file saved by fldump or flread is random: 2 sectors of
+// map, then at least a record
+  random = len >= 12 && memcmp( data, "#FLEX##RAND#", 12) == 0;
+  if (random && nbf < 3) {
+	free( data);
+	return 0x80;
+  }
+  if (nbf > disk.freesec || (first = alloc_sectors( nbf, 0)) < 0) {
+	free( data);
+	return 0x60;
+  }
+
+// Copy sectors
+  ibloc = last = first;
   for (i = 0; i < nbf; i++) {
-	for (k = 2; k < SECSIZE; k++)	// Clean sector
-	  current_sector[k] = 0;
-	j=fread( current_sector + 4, 1, 252, f_in);
-// If random file, manage differently the 2 first sectors
-	if (i == 0 && strcmp( current_sector + 4, "#FLEX##RAND#") == 0) {
-      file[k].random = 2;
-      entry->flags = 2;
-	  for (k = 4; k < 16; k++)
-		current_sector[k] = 0;
-	  current_sector = ts2pos( current_sector[0], current_sector[1]);
+	current_sector = getsec( ibloc);
+	memset( current_sector + 2, 0, SECSIZE - 2);	// Clean sector
+// If random file, the 2 first sectors are the map, rebuilt below
+	if (!random || i >= 2) {
+	  n = len - i * 252 < 252 ? len - i * 252 : 252;
+	  memcpy( current_sector + 4, data + i * 252, n);
+	  current_sector[2] = (uint8_t) ((i + 1 - 2 * random) / 256);
+	  current_sector[3] = (uint8_t) ((i + 1 - 2 * random) & 0xFF);
+	}
+	last = ibloc;
+	ibloc = get_link( ibloc);
+  }
+  free( data);
+  if (len % 252 != 0) {
+	retval |= 8;
+	if (verbose > 1)
+	  printf( "Padding file '%s' with '0's.\n", name);
+  }
+
+  if (old != nslot && delete_file( ffname)) {
+	free_sectors( first, last, nbf);
+	return 0x30;
+  }
+  entry = new_entry( k, filename, extension, nbf, random, mtime);
+  file[k].start_trk = entry->first_trk = blk2trk( first);
+  file[k].start_sec = entry->first_sec = blk2sec( first);
+  file[k].end_trk = entry->last_trk = blk2trk( last);
+  file[k].end_sec = entry->last_sec = blk2sec( last);
+
+// If random file, the first 2 sectors are the map of the data sectors
+  if (random && build_map( k) != 0) {
+	printf( "%sWarning: random file '%s' too fragmented, its map is incomplete%s\n",
+	  s_warn, ffname, s_norm);
+	retval |= 8;
+  }
+  return retval;
+}
+
+////////////////////////////////////////////////////////////
+// Can the map of a new random file of nbf sectors hold   //
+// all its runs ? Its sectors are taken from the freelist, //
+// followed by the chain of file old if it is deleted to  //
+// make room: a run of nbf consecutive sectors always     //
+// fits, else the nbf first ones are taken and their runs //
+// counted as build_map() does                            //
+// Return 1 if the map can be built, 0 if not             //
+////////////////////////////////////////////////////////////
+
+static int map_fits( int old, int nbf) {
+  int ibloc, prev, n, total, len, count, runs;
+
+  total = disk.freesec;
+  if (old != nslot && nbf > disk.freesec)
+	total += file[old].length;
+  ibloc = prev = 0;
+  len = count = runs = 0;
+  for (n = 0; n < total; n++) {
+	if (n == disk.freesec)
+	  ibloc = ts2blk( file[old].start_trk, file[old].start_sec);
+	else if (n == 0)
+	  ibloc = ts2blk( disk.dsk[0x21d], disk.dsk[0x21e]);
+	else
+	  ibloc = get_link( prev);
+	if (ibloc < 1)
+	  break;
+	len = n > 0 && ibloc == prev + 1 ? len + 1 : 1;
+	if (len >= nbf)
+	  return 1;
+// Data sectors, after the 2 of the map
+	if (n >= 2 && n < nbf) {
+	  if (count && ibloc == prev + 1 && count < 255)
+		count++;
+	  else {
+		runs++;
+		count = 1;
+	  }
+	}
+	prev = ibloc;
+  }
+  return runs <= MAXREC / 255;
+}
+
+/////////////////////////////////////////////////////////
+// Create an empty random file of nrec records, in one //
+// run of consecutive sectors if the freelist has one  //
+// Return as insert_file()                             //
+/////////////////////////////////////////////////////////
+
+int create_random( char *name, int nrec, int replace) {
+  struct Entry *entry; // directory entry
+  char filename[10]; // Flex file name
+  char extension[4]; // Flex file extension
+  int retval;
+  int first, last, ibloc;
+  int i, k, old, nbf;
+  uint8_t *psec;
+
+  retval = flex_name( name, filename, extension);
+// 2 map sectors, then the records
+  nbf = nrec + 2;
+  if (nrec < 1 || nbf > 0xFFFF)
+	return 0x60;
+// An existing file of same name is deleted once the new one is built,
+// so that it is kept if the new one doesn't fit. If it only fits in
+// its place, it is deleted first, once known that the map can be built
+  old = find_ffname();
+  if (old != nslot && replace == 0)
+	return 0x20;
+  if (nbf > disk.freesec + (old != nslot ? file[old].length : 0)
+	  || !map_fits( old, nbf))
+	return 0x60;
+  if (old != nslot && nbf > disk.freesec) {
+	if (delete_file( ffname))
+	  return 0x30;
+	old = nslot;
+  }
+  if (old != nslot)
+	k = old;
+  else if ((k = free_slot()) == nslot && (k = grow_dir()) < 0)
+	return 0x10;
+  if ((first = alloc_sectors( nbf, 1)) == -2) {
+	if (verbose)
+	  printf( "%sWarning: no run of %d free sectors, '%s' will be fragmented%s\n",
+		s_warn, nbf, ffname, s_norm);
+	first = alloc_sectors( nbf, 0);
+  }
+  if (first < 0)
+	return 0x60;
+
+// Clean sectors, data sectors numbered from 1
+  ibloc = last = first;
+  for (i = 0; i < nbf; i++) {
+	psec = getsec( ibloc);
+	memset( psec + 2, 0, SECSIZE - 2);
+	if (i >= 2) {
+	  psec[2] = (uint8_t) ((i - 1) / 256);
+	  psec[3] = (uint8_t) ((i - 1) & 0xFF);
+	}
+	last = ibloc;
+	ibloc = get_link( ibloc);
+  }
+
+  if (old != nslot && delete_file( ffname)) {
+	free_sectors( first, last, nbf);
+	return 0x30;
+  }
+  entry = new_entry( k, filename, extension, nbf, 1, time( NULL));
+  file[k].start_trk = entry->first_trk = blk2trk( first);
+  file[k].start_sec = entry->first_sec = blk2sec( first);
+  file[k].end_trk = entry->last_trk = blk2trk( last);
+  file[k].end_sec = entry->last_sec = blk2sec( last);
+
+  if (build_map( k) != 0) {  // checked by map_fits(): give the sectors back
+	free_sectors( first, last, nbf);
+	entry->name[0] = 0xFF;
+	file[k].flags |= 0x10;
+	file[k].name[0] = '?';
+	nfile--;
+	ndel++;
+	return 0x60;
+  }
+  return retval;
+}
+
+/////////////////////////////////////////////////////////
+// Append a Unix file at the end of the Flex file of   //
+// the same name: only the new sectors are taken from  //
+// the freelist and linked after the last one. Data    //
+// starts on a new sector, the last one of the file is //
+// already padded. The sectors changed are marked in  //
+// dirty[]                                             //
+// Return as insert_file(), 0x70 if no such Flex file  //
+/////////////////////////////////////////////////////////
+
+int append_file( char *name, char *dest) {
+  struct Entry *entry; // directory entry
+  char filename[10]; // Flex file name
+  char extension[4]; // Flex file extension
+  struct stat inbuf; // unix file metadata
+  FILE *f_in;
+  int retval;
+  int first, last, ibloc;
+  int i, k, n, nbf, seq;
+  uint8_t *data;     // content of the Unix file
+  long len;
+  uint8_t *psec;
+
+  retval = flex_name( dest != NULL ? dest : name, filename, extension);
+  k = find_ffname();
+  if (k == nslot || (file[k].flags & 0xC0) != 0)
+	return 0x70;
+
+  if (strcmp( name, "-") == 0)
+	f_in = stdin;
+  else {
+	if (stat( name, &inbuf) < 0) {
+	  if (verbose)
+		perror( name);
+	  return 0x40;
+	}
+	if ((inbuf.st_mode & S_IFMT) == S_IFDIR)
+	  return 0x50;
+	if ((f_in = fopen( name, "r")) == NULL) {
+	  if (verbose)
+		perror( name);
+	  return 0x40;
+	}
+  }
+
+// Read the whole file, then fill free sectors as in insert_file(),
+// sequence numbers follow the last sector (map sectors are not numbered)
+  data = read_input( f_in, &len);
+  if (f_in != stdin)
+	fclose( f_in);
+  if (data == NULL) {
+	perror( "malloc: ");
+	return 0x40;
+  }
+  if ((nbf = (len + 251) / 252) == 0) {
+	free( data);
+	return retval;
+  }
+  if (nbf > disk.freesec || file[k].length + nbf > 0xFFFF
+	  || (first = alloc_sectors( nbf, 0)) < 0) {
+	free( data);
+	return 0x60;
+  }
+  dirty[2] = 1;
+
+  seq = file[k].length - (file[k].flags & 0x02);
+  ibloc = last = first;
+  for (i = 0; i < nbf; i++) {
+	psec = getsec( ibloc);
+	memset( psec + 2, 0, SECSIZE - 2);
+	n = len - i * 252 < 252 ? len - i * 252 : 252;
+	memcpy( psec + 4, data + i * 252, n);
+	seq++;
+	psec[2] = (uint8_t) (seq / 256);
+	psec[3] = (uint8_t) (seq & 0xFF);
+	dirty[ibloc] = 1;
+	last = ibloc;
+	ibloc = get_link( ibloc);
+  }
+  free( data);
+  if (len % 252 != 0 && verbose > 1)
+	printf( "Padding file '%s' with '0's.\n", name);
+
+// Link the new sectors after the last one, update directory entry
+  ibloc = ts2blk( file[k].end_trk, file[k].end_sec);
+  set_link( ibloc, first);
+  dirty[ibloc] = 1;
+  entry = (struct Entry *)file[k].pos;
+  dirty[(file[k].pos - disk.dsk) / SECSIZE] = 1;
+  file[k].end_trk = entry->last_trk = blk2trk( last);
+  file[k].end_sec = entry->last_sec = blk2sec( last);
+  file[k].length += nbf;
+  entry->length[1] = file[k].length & 0xFF;
+  entry->length[0] = (uint8_t) (file[k].length / 256);
+
+  if (file[k].flags & 0x02) {
+	ibloc = ts2blk( file[k].start_trk, file[k].start_sec);
+	dirty[ibloc] = dirty[get_link( ibloc)] = 1;   // the map
+	if (build_map( k) != 0) {
+	  printf( "%sWarning: random file '%s' too fragmented, its map is incomplete%s\n",
+		s_warn, ffname, s_norm);
+	  retval |= 8;
+	}
+  }
+  return retval;
+}
+
+// Print the result of a copy or an append, as returned by insert_file()
+
+static void report( int done, char *name, int append) {
+  switch (done & 0xF0) {
+    case 0x10: printf( "%sERROR: No more directory entry available.%s\n", s_err, s_norm);
+  			 break;
+    case 0x20: printf( "%sWarning: file '%s' allready present on image", s_warn, name);
+  			 if (done & 0xF)
+  			   printf( " under the name '%s'.%s\n", ffname, s_norm);
+  			 else
+  			   printf( ".%s\n", s_norm);
+  			 printf( "Use -o option to overwrite it\n");
+  			 break;
+    case 0x30: printf( "%sERROR: Unable to delete '%s', file '%s' not copied.%s\n",
+  			        s_err, ffname, name, s_norm);
+  			 break;
+    case 0x40: printf( "%sERROR: can't stat/open file '%s'.%s\n", s_err, name, s_norm);
+  			 break;
+    case 0x50: printf( "%sERROR: File '%s' is not a regular file: ignored.%s\n",
+  					s_err, name, s_norm);
+  			 break;
+    case 0x60: printf( "%sERROR: Not enough space left to copy '%s', skipping it.%s\n",
+  					s_err, name, s_norm);
+  			 break;
+    case 0x70: printf( "%sERROR: No file '%s' on image to append '%s' to.%s\n",
+  					s_err, ffname, name, s_norm);
+  			 break;
+    case 0x80: printf( "%sERROR: '%s' is a random file without its map and a record: ignored.%s\n",
+  					s_err, name, s_norm);
+  			 break;
+    default:   if (verbose) {
+  			   printf( "%sFile '%s' %s", s_ok, name, append ? "appended" : "copied");
+  			   if (done & 0x0F)
+  				 printf( " %s '%s'.%s\n", append ? "to" : "as", ffname, s_norm);
+  			   else
+  				 printf( ".%s\n", s_norm);
+  			 }
+}
+}
+
+// A file of a batch insert
+
+struct Batch {
+  char *name;         // Unix file name
+  char ffname[16];    // Flex 'name.ext'
+  char filename[10];  // Flex file name
+  char extension[4];  // Flex file extension
+  int nbf;            // Number of blocs, 0 if not copied, -1 if streamed
+  int old;            // entry of the file replaced, -1 if none
+  int by;             // later file of the same Flex name copied instead, -1 if none
+  int random;         // Copy random file ?
+  time_t mtime;
+  int done;           // as returned by insert_file()
+};
+
+/////////////////////////////////////////////////////////////
+// Copy a list of files with one planning pass: the space  //
+// needed by all the regular files is checked once, their  //
+// sectors are taken together from the freelist (in one    //
+// run if there is one), directory entries are filled in   //
+// one sweep and the SIR is updated once. Other files      //
+// (pipes, devices) are then streamed by insert_file().    //
+// If the whole batch doesn't fit, files are copied one by //
+// one while space remains                                 //
+// Return the results of all files or'ed                   //
+/////////////////////////////////////////////////////////////
+
+int insert_batch( char **infile, int replace) {
+  struct Batch *b;
+  struct Entry *entry;
+  struct stat inbuf;
+  FILE *f_in;
+  char magic[12];
+  int *slot;         // free directory entries, in the order used
+  int nb, total, nfree, first, start, last, ibloc;
+  int i, j, k, n, retval;
+  uint8_t *psec;
+
+  for (nb = 0; infile[nb] != NULL; nb++)
+	;
+  b = calloc( nb, sizeof( struct Batch));
+  slot = malloc( (nslot + nb + 10) * sizeof( int));
+
+// Free entries first, then deleted ones, as free_slot() would
+  nfree = 0;
+  for (k = 0; k < nslot; k++)
+	if (file[k].flags == 0)
+	  slot[nfree++] = k;
+
+// Planning: Flex names, files replaced and sizes
+  for (i = 0; i < nb; i++) {
+	b[i].name = infile[i];
+	b[i].old = b[i].by = -1;
+	b[i].done = flex_name( infile[i], b[i].filename, b[i].extension);
+	strcpy( b[i].ffname, ffname);
+	if (stat( infile[i], &inbuf) < 0) {
+	  if (verbose)
+		perror( infile[i]);
+	  b[i].done = 0x40;
+	  continue;
+	}
+	if ((inbuf.st_mode & S_IFMT) != S_IFREG) {
+	  b[i].nbf = -1;
+	  continue;
+	}
+	for (j = 0; j < i; j++)     // Same name earlier in the batch ?
+	  if (b[j].nbf > 0 && strcmp( b[j].ffname, ffname) == 0)
+		break;
+	if (j < i) {
+	  if (replace == 0) {
+		b[i].done |= 0x20;
+		continue;
+	  }
+	} else if ((k = find_ffname()) != nslot) {
+	  if (replace == 0) {
+		b[i].done |= 0x20;
+		continue;
+	  }
+	  b[i].old = k;             // deleted once the new one is copied
+	}
+	if ((f_in = fopen( infile[i], "r")) == NULL) {
+	  if (verbose)
+		perror( infile[i]);
+	  b[i].done = 0x40;
 	  continue;
 	}
-	if (i > 1 || entry->flags == 0) {
-	  current_sector[3] = (uint8_t) ((i + 1 - entry->flags) & 0xFF);
-	  if (i > 255)
-		current_sector[2] = (uint8_t) (((i + 1 - entry->flags) % 256) & 0xFF);
+	b[i].random = fread( magic, 1, 12, f_in) == 12 && memcmp( magic, "#FLEX##RAND#", 12) == 0;
+	fclose( f_in);
+	b[i].nbf = (inbuf.st_size + 251) / 252;
+	if (inbuf.st_size % 252 != 0) {
+	  b[i].done |= 8;
+	  if (verbose > 1)
+		printf( "Padding file '%s' with '0's.\n", infile[i]);
 	}
-	if (i < nbf - 1) {
-	  cftrk = current_sector[0];
-	  cfsec = current_sector[1];
-	  current_sector = ts2pos( cftrk, cfsec);
+	if (b[i].nbf == 0)          // An empty file still needs a sector
+	  b[i].nbf = 1;
+	if (b[i].random && b[i].nbf < 3) {
+	  b[i].done |= 0x80;
+	  b[i].nbf = 0;
+	}
+	b[i].mtime = inbuf.st_mtime;
+	if (j < i && b[i].nbf > 0) {  // the earlier one is not copied
+	  b[j].nbf = 0;
+	  b[j].by = i;
+	  b[i].old = b[j].old;
 	}
   }
 
-// Update free sector list start, update link of file's last sector
-	  entry->last_trk = cftrk;
-	  entry->last_sec = cfsec;
-      disk.dsk[0x21d] = current_sector[0];
-      disk.dsk[0x21e] = current_sector[1];
-	  current_sector[0] = 0;
-	  current_sector[1] = 0;
-
-// If random file, verify sectors continuity and update first 2 sectors
-	  if (random) {
-		current_sector = ts2pos( entry->first_trk, entry->first_sec);	// index sector
-		base = current_sector + 4;
-		ibloc = ts2blk( current_sector[0], current_sector[1]);
-		ibloc = nxtsec[ibloc];	// first data sector
-		base[0] = blk2trk( ibloc);
-		base[1] = blk2sec( ibloc);
-		k = 1;
-		for (i = 0; i < nbf - 3; i++) {
-		  if (nxtsec[ibloc] == ibloc + 1) {
-			k++;
-			ibloc++;
-		  } else if (nxtsec[ibloc] > 0) {
-			base[2] = k;
-			ibloc = nxtsec[ibloc];
-			base += 3;
-			if (base - current_sector >= 256) {
-			  current_sector = ts2pos( current_sector[0], current_sector[1]);
-			  base = current_sector + 4;
-			}
-			base[0] = blk2trk( ibloc);
-			base[1] = blk2sec( ibloc);
-			k = 1;
-		  } else
-			break;
+// Then deleted entries
+  for (k = 0; k < nslot; k++)
+	if ((file[k].flags & 0x10) == 0x10)
+	  slot[nfree++] = k;
+
+// Directory full: grow it beyond track 0, if the whole batch fits
+  for (i = j = total = 0; i < nb; i++)
+	if (b[i].nbf > 0) {
+	  if (b[i].old < 0)
+		j++;
+	  total += b[i].nbf;
+	}
+  first = -1;
+  if (j <= nfree || total + (j - nfree + 9) / 10 <= disk.freesec) {
+	while (nfree < j && (k = grow_dir()) >= 0)
+	  for (n = 0; n < 10; n++)
+		slot[nfree++] = k + n;
+
+// Files beyond the last entry free are not copied
+	total = 0;
+	for (i = j = 0; i < nb; i++)
+	  if (b[i].nbf > 0) {
+		if (b[i].old >= 0 || j++ < nfree)
+		  total += b[i].nbf;
+		else {
+		  b[i].done = 0x10;
+		  b[i].nbf = 0;
 		}
-		base[2] = k;
 	  }
-	  fclose( f_in);
-	  return retval;
+	if (total > 0 && total <= disk.freesec)
+	  if ((first = alloc_sectors( total, 1)) == -2)
+		first = alloc_sectors( total, 0);
+  }
+
+// Copy sectors and fill directory entries
+  ibloc = first;
+  for (i = j = 0; first > 0 && i < nb; i++) {
+	if (b[i].nbf <= 0)
+	  continue;
+	f_in = fopen( b[i].name, "r");
+	start = last = ibloc;
+	for (n = 0; n < b[i].nbf; n++) {
+	  psec = getsec( ibloc);
+	  memset( psec + 2, 0, SECSIZE - 2);	// Clean sector
+	  if (f_in != NULL)
+		flstat.rbytes += fread( psec + 4, 1, 252, f_in);
+// If random file, the 2 first sectors are the map, rebuilt below
+	  if (b[i].random && n < 2)
+		memset( psec + 4, 0, 252);
+	  else {
+		psec[2] = (uint8_t) ((n + 1 - 2 * b[i].random) / 256);
+		psec[3] = (uint8_t) ((n + 1 - 2 * b[i].random) & 0xFF);
+	  }
+	  last = ibloc;
+	  ibloc = get_link( ibloc);
+	}
+	set_link( last, 0);
+	if (f_in == NULL) {         // vanished since planning
+	  if (verbose)
+		perror( b[i].name);
+	  free_sectors( start, last, b[i].nbf);
+	  b[i].done = 0x40;
+	  continue;
+	}
+	fclose( f_in);
+
+	strcpy( ffname, b[i].ffname);
+	if ((k = b[i].old) < 0)
+	  k = slot[j++];
+	else if (delete_file( ffname)) {
+	  free_sectors( start, last, b[i].nbf);
+	  b[i].done = 0x30;
+	  continue;
+	}
+	entry = new_entry( k, b[i].filename, b[i].extension, b[i].nbf,
+	                   b[i].random, b[i].mtime);
+	file[k].start_trk = entry->first_trk = blk2trk( start);
+	file[k].start_sec = entry->first_sec = blk2sec( start);
+	file[k].end_trk = entry->last_trk = blk2trk( last);
+	file[k].end_sec = entry->last_sec = blk2sec( last);
+	if (b[i].random && build_map( k) != 0) {
+	  printf( "%sWarning: random file '%s' too fragmented, its map is incomplete%s\n",
+		s_warn, ffname, s_norm);
+	  b[i].done |= 8;
+	}
+  }
+
+// Not enough space for all: one by one
+  for (i = 0; first < 0 && i < nb; i++)
+	if (b[i].nbf > 0)
+	  b[i].done = insert_file( b[i].name, NULL, replace);
+
+// Files that are not regular are streamed
+  for (i = 0; i < nb; i++)
+	if (b[i].nbf < 0)
+	  b[i].done = insert_file( b[i].name, NULL, replace);
+
+  retval = 0;
+  for (i = 0; i < nb; i++) {
+	strcpy( ffname, b[i].ffname);
+	if (b[i].by >= 0)
+	  printf( "%sWarning: file '%s' not copied, '%s' has the same Flex name '%s'.%s\n",
+		s_warn, b[i].name, b[b[i].by].name, ffname, s_norm);
+	else
+	  report( b[i].done, b[i].name, 0);
+	retval |= b[i].done;
+  }
+  free( slot);
+  free( b);
+  return retval;
 }
 
 // Program start here
 int main( int argc, char **argv)
 {
   char *term, *getenv( const char *name);
+  static struct option longopts[] = { STATS_OPTION,
+	{ "random-create", required_argument, 0, 'R' },
+	{ "records", required_argument, 0, 'N' },
+	{ "append", no_argument, 0, 'A' },
+	{ "name", required_argument, 0, 'n' },
+	{ 0, 0, 0, 0 } };
   int opt;
   char filepath[256];
-  char *backup;
   struct stat dsk_stat;
   int retval, done;
   int strict = 1;
   int force = 0;
   int delete = 0;
   int overwrite = 0;
+  int append = 0;
+  char *rname = NULL; // random file to create
+  char *dest = NULL;  // Flex name of the only infile
+  int nrec = 0;
   char **infile;
-  int i;
+  int *found;         // files matched by each pattern to delete
+  int i, k, n;
 
-  while ((opt = getopt( argc, argv, "hvdfo")) != -1) {
+  while ((opt = getopt_long( argc, argv, "hvdfo", longopts, NULL)) != -1) {
 	switch (opt) {
 	case 'h':
 	  usage( *argv);
@@ -362,6 +973,21 @@ int main( int argc, char **argv)
 	case 'o':
 	  overwrite = 1;
 	  break;
+	case 'S':
+	  stats_init( *argv, optarg);
+	  break;
+	case 'A':
+	  append = 1;
+	  break;
+	case 'n':
+	  dest = optarg;
+	  break;
+	case 'R':
+	  rname = optarg;
+	  break;
+	case 'N':
+	  nrec = atoi( optarg);
+	  break;
 	default: /* '?' */
 	  usage( *argv);
 	  exit( 3);
@@ -371,7 +997,19 @@ int main( int argc, char **argv)
   if (strcmp( argv[0], "fldel") == 0)
 	delete = 1;
 
-  if (argc - optind < 2) {
+  if (append && (delete || overwrite)) {
+	fprintf( stderr, "--append can't be used with -d or -o\n");
+	usage( *argv);
+	exit( 2);
+  }
+
+  if (rname != NULL && (delete || nrec < 1 || nrec > MAXREC)) {
+	fprintf( stderr, "--random-create needs --records between 1 and %d (the most a map holds)\n", MAXREC);
+	usage( *argv);
+	exit( 2);
+  }
+
+  if (argc - optind < (rname == NULL ? 2 : 1)) {
 	fprintf( stderr, "Not enough file names...\n");
 	usage( *argv);
 	exit( 2);
@@ -387,6 +1025,18 @@ int main( int argc, char **argv)
   }
   infile[i] = NULL;
 
+  if (dest != NULL && (i != 1 || delete)) {
+	fprintf( stderr, "--name needs one and only one infile\n");
+	usage( *argv);
+	exit( 2);
+  }
+  for (i = 0; infile[i] != NULL; i++)
+	if (strcmp( infile[i], "-") == 0 && (dest == NULL || delete)) {
+	  fprintf( stderr, "Standard input '-' needs a Flex name given by --name\n");
+	  usage( *argv);
+	  exit( 2);
+	}
+
 // If possible, colorize Warnings and Errors
   if (isatty( 1) && (term = getenv( "TERM")) != NULL) {
     if (strstr( term, "256color") != NULL) {
@@ -406,35 +1056,13 @@ int main( int argc, char **argv)
 	exit( 2);
   }
 
-  disk.shortname = strrchr( filepath, '/');
-  if (disk.shortname == NULL)
-	disk.shortname = filepath;
-  else
-	disk.shortname++;
-
   if ((dsk_stat.st_mode & S_IWUSR) == 0) {
-    fprintf( stderr, "ERROR: %s is not writable!\n", disk.shortname);
-	exit( 2);
-  }
-
-  if ((disk.fd = open( filepath, O_RDONLY)) < 0 ) {
-	perror( filepath);
+    fprintf( stderr, "ERROR: %s is not writable!\n", filepath);
 	exit( 2);
   }
 
-  disk.size = dsk_stat.st_size;
-  disk.dsk = malloc( dsk_stat.st_size);
-
-  if (disk.dsk == NULL) {
-    perror( "malloc: ");
-    exit( 3);
-  }
-
-  if (read( disk.fd, disk.dsk, dsk_stat.st_size) != dsk_stat.st_size) {
-	perror( filepath) ;
+  if (load_image( filepath, 0))
 	exit( 3);
-  }
-  close( disk.fd);
 
   // Is it a clean flex image ?
 
@@ -453,7 +1081,7 @@ int main( int argc, char **argv)
 	exit( 2);
   }
 
-  retval = analyse( 1);
+  retval = analyse_cached( filepath, 1);
   if (retval> 1)
 	return retval;
   else if (retval == 1)
@@ -462,74 +1090,74 @@ int main( int argc, char **argv)
   if (verbose)
     putchar( '\n');
 
-  for (i = 0; infile[i] != NULL; i++) {
-	if (delete) {
-	  done = delete_file( infile[i]);
-	  if (verbose)
-	    if (done == 0)
-	      printf( "%sFile '%s' deleted%s\n", s_ok, infile[i], s_norm);
-	    else
+  if (rname != NULL) {
+	stat_start( PH_INSERT);
+	done = create_random( rname, nrec, overwrite);
+	stat_stop( PH_INSERT);
+	switch (done & 0xF0) {
+	  case 0x10: printf( "%sERROR: No more directory entry available.%s\n", s_err, s_norm);
+				 break;
+	  case 0x20: printf( "%sWarning: file '%s' allready present on image.%s\n", s_warn, ffname, s_norm);
+				 printf( "Use -o option to overwrite it\n");
+				 break;
+	  case 0x30: printf( "%sERROR: Unable to delete '%s'.%s\n", s_err, ffname, s_norm);
+				 break;
+	  case 0x60: printf( "%sERROR: Not enough space left for %d records of '%s'.%s\n",
+						s_err, nrec, ffname, s_norm);
+				 break;
+	  default:   if (verbose)
+				   printf( "%sRandom file '%s' of %d records created.%s\n", s_ok, ffname, nrec, s_norm);
+	}
+	retval |= done;
+  }
+
+// Delete: all patterns in one directory pass
+  if (delete) {
+	found = malloc( argc * sizeof( int));
+	stat_start( PH_DELETE);
+	delete_files( infile, found);
+	stat_stop( PH_DELETE);
+	for (i = 0; infile[i] != NULL; i++)
+	  if (found[i] == 0) {
+		if (verbose)
 		  printf( "%sFile '%s' not found !%s\n", s_warn, infile[i], s_norm);
-	} else {
-		done = insert_file( infile[i], overwrite);
-		switch (done & 0xF0) {
-		  case 0x10: printf( "%sERROR: No more directory entry available.%s\n", s_err, s_norm);
-					 break;
-		  case 0x20: printf( "%sWarning: file '%s' allready present on image", s_warn, infile[i]);
-					 if (done & 0xF)
-					   printf( " under the name '%s'.%s\n", ffname, s_norm);
-					 else
-					   printf( ".%s\n", s_norm);
-					 printf( "Use -o option to overwrite it\n");
-					 break;
-		  case 0x30: printf( "%sERROR: Unable to delete '%s', file '%s' not copied.%s\n",
-					        s_err, ffname, infile[i], s_norm);
-   					 break;
-		  case 0x40: printf( "%sERROR: can't stat/open file '%s'.%s\n", s_err, infile[i], s_norm);
-					 break;
-		  case 0x50: printf( "%sERROR: File '%s' is not a regular file: ignored.%s\n",
-							s_err, infile[i], s_norm);
-					 break;
-		  case 0x60: printf( "%sERROR: Not enough space left to copy '%s', skipping it.%s\n",
-							s_err, infile[i], s_norm);
-					 break;
-		  default:   if (verbose) {
-					   printf( "%sFile '%s' copied", s_ok, infile[i]);
-					   if (done & 0x0F)
-						 printf( " as '%s'.%s\n", ffname, s_norm);
-					   else
-						 printf( ".%s\n", s_norm);
-					 }
-		}
+		retval |= 1;
+	  }
+	free( found);
+// Plain copy: all files in one batch
+  } else if (!append && dest == NULL) {
+	stat_start( PH_INSERT);
+	retval |= insert_batch( infile, overwrite);
+	stat_stop( PH_INSERT);
+  } else {
+	if (append && rname == NULL)   // else the random file is saved too
+	  dirty = calloc( disk.nb_sectors, 1);
+	for (i = 0; infile[i] != NULL; i++) {
+	  stat_start( PH_INSERT);
+	  done = append ? append_file( infile[i], dest) : insert_file( infile[i], dest, overwrite);
+	  stat_stop( PH_INSERT);
+	  report( done, infile[i], append);
+	  retval |= done;
 	}
-    retval |= done;
   }
 
   if (verbose)
 	list_files( verbose-1);
 
-  // rename original file
-  backup = malloc( strlen( filepath) + 4);
-  strcpy( backup, filepath);
-  strcat( backup, ".bak");
-  if (rename( filepath, backup)) {
-	perror( "backup: ");
+// Append: only the sectors changed are written, by runs
+  if (dirty != NULL) {
+	for (i = 0; i < disk.nb_sectors; i = k) {
+	  for (k = i; k < disk.nb_sectors && dirty[k]; k++)
+		;
+	  if ((n = k - i) > 0 && write_sectors( filepath, i, n))
+		return 3;
+	  if (n == 0)
+		k++;
+	}
+  // else rename original file and write the modified one
+  } else if (save_image( filepath))
 	return 3;
-  }
-
-  // create modified file
-  disk.fd = creat( filepath, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
 
-  if (disk.fd == -1) {
-    perror( "create: ");
-    exit( 3);
-  }
-
-  if (write( disk.fd, disk.dsk, dsk_stat.st_size) != dsk_stat.st_size) {
-	perror( "rewrite: ") ;
-	exit( 3);
-  }
-  close( disk.fd);
   if (retval & 0xF0)
 	return 2;
   else if (retval & 0x0F)
@@ -22,18 +22,13 @@
 #include <string.h>
 #include <ctype.h>
 #include <getopt.h>
+#include "flstats.h"
+#include "flconv.h"
 
 #ifndef NULL
 #define NULL 0
 #endif
 
-char *errmsg[] = {  "Empty input file", 
-                    "Not a Motorola S19 file",
-                    "Unexpected char or EOF",
-                    "Checksum error",
-                    "24 or 32 bits addresses not supported",
-                    "Address overflow"
-                 };
 int verbose = 0;
 int line = 1;
 
@@ -41,160 +36,26 @@ int line = 1;
 
 void usage( char *cmd) {
     fprintf( stderr, "Usage: %s [-h] => this help\n", cmd);
-    fprintf( stderr, "Usage: %s [-v] <input_file> [<output_file>]\n", cmd);
+    fprintf( stderr, "Usage: %s [-v] [--stats[=json]] <input_file> [<output_file>]\n", cmd);
 }
 
-// GetHex : retrieves a hex value in given length from file
+// reads19 : read the whole S19 file in memory
 
-int GetHex(FILE *f, int nChars) {
-  int out = 0;
+char *reads19( FILE *fi, size_t *len) {
+  char *buf = NULL;
+  size_t size = 0, n;
 
-  while ( nChars--) {
-    int c = getc(f);
-    if (c == EOF)
-      return -1;
-    if (c >= 'a')
-      c -= ('a' - 'A');
-    if ((!((c >= '0') && (c <= '9'))) &&
-        (!((c >= 'A') && (c <= 'F'))))
-    return -1;
-    c -= '0';
-    if (c > 9)
-      c -= 7;
-    out = out * 16 + c;
-  }
-
-  return out;
-}
-
-// printbuf : write binary data in CMD file, keep trace of size
-
-int printbuf( FILE *fo, int *buffer, int index) {
-  for (int i = 0; i < index; i++)
-    fputc( buffer[i], fo);
-  if (verbose)
-    fprintf( stderr, "write %d bytes at 0x%4X\n", index, (buffer[1] << 8) + buffer[2]);
-  return index;
-}
-
-// gets19 : read S19 data and write a .CMD Flex file
-
-int gets19( FILE *fi, FILE *fo) {
-
-  int buffer[256], i, j;                 // output buffer
-  char nLineType;
-  int c = 0;
-  int index = 0;
-  int nBytes = 0;
-  int count = 0;
-  int nAddr = 0;
-  int checksum;
-  int address = 0;
-
-  // clear buffer
-  for (i=0; i<256; i++)
-      buffer[i]=0;
-
-  while (1) {
-    c = getc(fi) ;
-    if ((c == '\r') || (c == '\n')) {
-	  line++;
-      continue ;                         // skip newline
-	}
-    if (c == EOF) {
-      if (index == 0)                    // Empty file...
-        return 1;
-      else {
-        nBytes += printbuf( fo, buffer, index);
-        for (i=0; i<252-(nBytes%252); i++)
-          fputc( 0, fo);
-        return 0;
-      }
+  *len = 0;
+  do {
+    if (*len == size) {
+      size = size ? 2 * size : 65536;
+      if ((buf = realloc( buf, size)) == NULL)
+        return NULL;
     }
-    //printf ("0x%02X(%c) ", c, c);
-    if (c != 'S')                        // Starting with 'S' ?
-      return 2;                          // No :-(
-  
-    nLineType = getc( fi);
-    if ((count = GetHex(fi,2)) < 3)      // Always between 3 and 255
-      return 3;
-    if ((nAddr = GetHex(fi,4)) < 0)      // Address between 0 and 0xFFFF
-      return 3;
-    checksum = count + (nAddr >> 8) + (nAddr & 0xFF);
-    //printf( "count = %d, addr = 0x%4X, chksum = 0x%X\n", count, nAddr, checksum);
-    count -= 3;
-
-    switch (nLineType)                   // Examine line type
-    {
-      // Header record, ignore it except for checksum
-      // and for printing it if verbose
-      case '0' :
-        if (verbose)
-          fprintf( stderr, "Header: \"");
-        while (count--) {
-          c = GetHex(fi, 2);
-          checksum += c;
-          if (verbose)
-            fputc( c, stderr);
-        }
-        if (verbose)
-          fprintf( stderr, "\"\n");
-        break;
-      // Data record (count is always less than 255)
-      case '1' :
-        if ((index + count > 255) || (address != nAddr)) {
-          buffer[3] = index - 4;
-          if (index)
-            nBytes += printbuf( fo, buffer, index);
-          index = 0;
-        }
-
-        if (index == 0) {
-          buffer[0] = 2;
-          buffer[1] = nAddr >> 8;
-          buffer[2] = nAddr & 0xFF;
-          index = 4;
-          address = nAddr;
-        } 
-
-        for (i = 0; i < count; i++) {
-          if ( ++address > 0xFFFF)
-            return 6;
-          c = GetHex(fi, 2);             // retrieve a byte
-          checksum += c;
-          buffer[index++] = c;
-        }
-
-        break;
-      // 24bit and 32bit data not useful for Flex...
-      case '2' :                         // record with 24bit address
-      case '3' :                         // record with 32bit address
-      case '7' :                         // 32-bit entry point
-      case '8' :                         // 24-bit entry point
-        return 5;
-      // S5/S6 records ignored; don't think they make any sense here
-      case '5' :
-      case '6' :
-        break;
-      case '9' :
-        buffer[3] = index - 4;
-        // nBytes += printbuf( fo, buffer, index);
-        // index = 0;
-        buffer[index++] = 0x16;
-        buffer[index++] = nAddr >> 8;
-        buffer[index++] = nAddr & 0xFF;
-        if (verbose)
-          fprintf( stderr, "Load address = 0x%4X\n", nAddr);
-        break;
-      default :                          // Type not registered
-        return 2;                        // Should not happen
-        break;
-      }
-    c = GetHex(fi, 2);                   // read checksum
-    if (((checksum + c) & 0xFF) ^ 0xFF)  // compute checksum
-      return 4;
-  }
-  return 0;
+    n = fread( buf + *len, 1, size - *len, fi);
+    *len += n;
+  } while (n > 0);
+  return buf;
 }
 
 // Program start here
@@ -203,13 +64,17 @@ int main( int argc, char *argv[]) {
   char *fname = NULL, *pname = NULL;
   int i, opt;
   int status;
+  char *s19;
+  uint8_t *cmd;
+  size_t len, cmdlen;
   FILE *input;
   FILE *output;
 
   char outname[13];
+  static struct option longopts[] = { STATS_OPTION, { 0, 0, 0, 0 } };
 
   // Read parameters
-  while ((opt = getopt( argc, argv, "hv")) != -1) {
+  while ((opt = getopt_long( argc, argv, "hv", longopts, NULL)) != -1) {
     switch (opt) {
     case 'h':
       usage( *argv);
@@ -218,6 +83,9 @@ int main( int argc, char *argv[]) {
     case 'v':
       verbose = 1;
       break;
+    case 'S':
+      stats_init( *argv, optarg);
+      break;
     default: /* '?' */
       if (isprint (optopt))
           fprintf( stderr, "Unknown option '-%c'.\n", optopt);
@@ -273,10 +141,21 @@ int main( int argc, char *argv[]) {
   }
 
   // All is done here
-  status = gets19( input, output);
+  if ((s19 = reads19( input, &len)) == NULL || (cmd = malloc( CMD_MAX( len))) == NULL) {
+    perror( argv[0]);
+    exit( 2);
+  }
+  flstat.rbytes += len;
+  stat_start( PH_CONVERT);
+  status = s19_to_cmd( s19, len, cmd, &cmdlen, &line, verbose ? stderr : NULL);
+  stat_stop( PH_CONVERT);
+  if (status == 0) {
+    fwrite( cmd, 1, cmdlen, output);
+    flstat.wbytes += cmdlen;
+  }
 
   if (status)
-    fprintf( stderr, "Error: %s, line %d\n", errmsg[status-1], line);
+    fprintf( stderr, "Error: %s, line %d\n", s19_errmsg[status-1], line);
 
   if (input)
     fclose(input);
@@ -44,6 +44,7 @@ int isFlex( uint8_t *dsk, long nsect) {
 
   long size;       // size calculated if not Flex
 
+  stat_start( PH_ISFLEX);
   disk.nb_sectors = disk.size / SECSIZE;
   if (!quiet) {
     printf( "File name: %s\n", disk.shortname);
@@ -51,6 +52,7 @@ int isFlex( uint8_t *dsk, long nsect) {
     if (disk.nb_sectors * SECSIZE != disk.size) {
       printf( "[disk size doesn't match an integer number of sectors: %u bytes left]\n",
         disk.size % SECSIZE);
+      stat_stop( PH_ISFLEX);
       return 0;
     }
   }
@@ -78,8 +80,10 @@ int isFlex( uint8_t *dsk, long nsect) {
       else // It's something other...
         printf( "Unknown disk image type\n");
     }
+    stat_stop( PH_ISFLEX);
     return 0;
   }
+  stat_stop( PH_ISFLEX);
   return 1;
 }
 
@@ -95,7 +99,8 @@ int badFlex( int strict) {
   int retval = 0;       // value returned if problem detected
                         // 0: everything is ok; 1: freelist uncomplete/damaged
                         // 2: disk structure too damaged to continue
-  
+
+  stat_start( PH_BADFLEX);
   disk.volnum = disk.dsk[0x21b]*256 + disk.dsk[0x21c];
   // Size of disk & free sector list
   disk.nbtrk = disk.dsk[0x226];
@@ -146,8 +151,10 @@ int badFlex( int strict) {
         printf( "%sUnknown geometry: %d tracks of %d", s_err, disk.nbtrk, disk.nbsec);
         printf( " sectors and a first track of %d sectors !%s\n", disk.track0l, s_norm);
       }
-      if (strict)
+      if (strict) {
+        stat_stop( PH_BADFLEX);
         return 2;
+      }
       disk.track0l = disk.nbsec;
       disk.nbtrk++;
       last_trk_sec = disk.nb_sectors - (disk.nbtrk-1)*disk.nbsec - disk.track0l;
@@ -192,6 +199,142 @@ int badFlex( int strict) {
         disk.dsk[0x21d], disk.dsk[0x21e], disk.dsk[0x21f], disk.dsk[0x220]);
   }
 
+  stat_stop( PH_BADFLEX);
+  return retval;
+}
+
+//////////////////////////////////////////////////////
+// Next bloc in a chain: from nxtsec when the whole //
+// disk was analysed, else from the sector link     //
+// Return -1 if the link is out of bounds           //
+//////////////////////////////////////////////////////
+
+static int nextblk( int ibloc) {
+  uint8_t *psec;
+
+  flstat.hops++;
+  if (nxtsec != NULL)
+    return nxtsec[ibloc];
+  psec = getsec( ibloc);
+  return ts2blk( psec[0], psec[1]);
+}
+
+/////////////////////////////////////////////////////
+// Verify the record number of bloc ibloc, n-th of //
+// file k: data sectors are numbered from 1, the   //
+// two map sectors of a random file have number 0. //
+// The first mismatch of a file is reported and    //
+// sets flag 0x08 (reordered or spliced chain)     //
+/////////////////////////////////////////////////////
+
+static void check_seq( int k, int n, int ibloc, uint8_t *psec) {
+  int seq, expected;
+
+  if (file[k].flags & 0x08)
+    return;
+  if (file[k].flags & 2)
+    expected = n < 2 ? 0 : n - 1;
+  else
+    expected = n + 1;
+  seq = psec[2] * 256 + psec[3];
+  if (seq != (expected & 0xFFFF)) {
+    printf( "%sERROR: File %s (%d), sector [0x%02X/0x%02X] is record %d instead of %d%s\n",
+      s_err, file[k].name, k+1, blk2trk( ibloc), blk2sec( ibloc), seq, expected, s_norm);
+    file[k].flags |= 0x08;
+  }
+}
+
+/////////////////////////////////////////////////////
+// Read the directory entries into the file table  //
+// Directory blocs are followed from sector 5 on   //
+// Return 2 if an entry has an invalid first bloc  //
+/////////////////////////////////////////////////////
+
+static int scan_dir( int dirsize, int *nbdirsec) {
+
+  int ibloc;              // current directory bloc
+  int j, k;               // loop index / counter
+  char name[16];          // temp file name
+  int retval = 0;
+
+  nfile = 0;
+  nslot = 0;
+  usedsec = 0;
+
+  ibloc = ts2blk( 0, 5);  // dir starts on sector 5 (offset = 0x400)
+
+  while (nslot < dirsize) {
+    if (ibloc >= disk.track0l) // directory bloc ouside track 0
+      (*nbdirsec)++;
+    dirsec = (struct Dirsec*)getsec( ibloc);
+    for (k=0; k < 10 && nslot < dirsize; k++) {
+      if (dirsec->entry[k].name[0] == 0) {
+        memset( &file[nslot], 0, sizeof( struct File));
+        file[nslot].pos = dirsec->entry[k].name;
+		nslot++;
+		continue;
+	  }
+      file[nslot].pos = dirsec->entry[k].name;
+      file[nslot].flags = 1;
+      if (dirsec->entry[k].f_day < 1 || dirsec->entry[k].f_day > 31)
+        file[nslot].day = 0;
+      else
+        file[nslot].day = (int)dirsec->entry[k].f_day;
+      if (dirsec->entry[k].f_month < 1 || dirsec->entry[k].f_month > 12)
+        file[nslot].month = 0;
+      else
+        file[nslot].month = (int)dirsec->entry[k].f_month;
+      if (dirsec->entry[k].f_year > 75)
+        file[nslot].year = (int)dirsec->entry[k].f_year + 1900;
+      else
+        file[nslot].year = (int)dirsec->entry[k].f_year + 2000;
+
+      if (dirsec->entry[k].flags) {  // random file
+        file[nslot].flags |= 2;
+      }
+      file[nslot].length = dirsec->entry[k].length[0]*256+dirsec->entry[k].length[1];
+
+//Name valid ?
+      if (getname( dirsec->entry[k].name, name, 1) < 0) {
+        printf( "%sERROR: Directory entry %d : name not valid%s\n",
+          s_err, nslot, s_norm);
+        file[nslot].flags |= 0x40;
+      }
+	  if (*name == 0)
+	    strcpy( name, "???");
+      strcpy( file[nslot].name, name);
+      file[nslot].start_trk = dirsec->entry[k].first_trk;
+      file[nslot].start_sec = dirsec->entry[k].first_sec;
+      file[nslot].end_trk   = dirsec->entry[k].last_trk;
+      file[nslot].end_sec   = dirsec->entry[k].last_sec;
+
+// first sector valid ?
+      j = ts2blk( dirsec->entry[k].first_trk, dirsec->entry[k].first_sec);
+      if ((j < 1 || j == 2) && *name != 0xFF && dirsec->entry[k].length[2] != 0) { 
+        printf( "%sERROR: Directory entry %d (%s) : sector [%02X,%02X] not valid%s\n",
+          s_err, nslot, name, dirsec->entry[k].first_trk, dirsec->entry[k].first_sec, s_norm);
+        file[nslot].length = 0;
+        file[nslot].flags |= 0x80;
+        retval = 2;
+        continue;
+      }
+// Deleted file ?
+      if (dirsec->entry[k].name[0] == 0xFF) {
+        file[nslot].name[0] = '?';
+        ndel++;
+        file[nslot].flags |= 0x10;
+      } else {
+	    nfile++;
+        usedsec += file[nslot].length;
+      }
+      nslot++;
+    }
+
+    // End of directory blocs ?
+    if ((ibloc = nextblk( ibloc)) <= 0)
+      break;
+  }
+
   return retval;
 }
 
@@ -207,13 +350,20 @@ int analyse( int strict) {
   int nbdirsec;           // number of directory's sectors not on track 0
 
   uint8_t *psec, *pbloc;  // pointers for bloc navigation
+  uint8_t *seen;          // blocs already walked for deleted files
   int obloc, ibloc;       // bloc index for navigation
   int j, k;               // loop index / counter
   int nb_blk;             // nb of blocs used by a file (computed)
-  char name[16];          // temp file name
 
   int retval = 0;         // return value (0 if OK)
 
+  stat_start( PH_ANALYSE);
+// The whole disk is needed here
+  if (load_all()) {
+    stat_stop( PH_ANALYSE);
+    return 3;
+  }
+
 // table of all blocs of the disk:
 // tabsec may contain :
 // * the directory entry number of the file using it
@@ -242,18 +392,20 @@ int analyse( int strict) {
       disk.dsk[ibloc*SECSIZE+1] = 0;
     }
   }
+  flstat.sectors += disk.nb_sectors;
 
 // verifying freelist blocs
   k = 0;
   ibloc = ts2blk( disk.dsk[0x21d], disk.dsk[0x21e]);
 
   while (ibloc != 0 && ibloc != -1) {
-    k++;
     if (tabsec[ibloc] == -1) { // duplicate sector in freelist
       if (strict)
         fprintf( stderr, "ERROR: Bad freelist, bloc %d duplicated\n", ibloc);
       retval = 1;
+      break;                   // the freelist loops, don't follow it again
     }
+    k++;
     if (tabsec[ibloc] == -99998 && strict) {
       printf( "%sWarning: freelist contains track 0 bloc %d%s\n",
       s_warn, ibloc, s_norm);
@@ -262,6 +414,7 @@ int analyse( int strict) {
     tabsec[ibloc] = -1;
     obloc = ibloc;
     ibloc = nxtsec[ibloc];
+    flstat.hops++;
   }
 
   if (k != disk.freesec) { // bad size
@@ -272,8 +425,13 @@ int analyse( int strict) {
     retval = 1;      
   }
 
-  lasttrk = blk2trk(obloc);
-  lastsec = blk2sec(obloc);
+  if (k == 0) {        // empty freelist: its end is 0/0, as its start
+    lasttrk = 0;
+    lastsec = 0;
+  } else {
+    lasttrk = blk2trk(obloc);
+    lastsec = blk2sec(obloc);
+  }
   if ( lasttrk != disk.dsk[0x21f] || lastsec != disk.dsk[0x220]) {
     if (strict | !quiet)
       printf( "%sWARNING: bad free list end [0x%02X/0x%02X] instead of [0x%02X/0x%02X]%s\n",
@@ -302,10 +460,12 @@ int analyse( int strict) {
       } else {
         printf( "%sERROR: Directory sector %d [0x%02X/0x%02X] used twice (loop)%s\n",
           s_err, ibloc, blk2trk( ibloc), blk2sec( ibloc), s_norm);
+        stat_stop( PH_ANALYSE);
         return 3; // No need to go further !
       }
     }
     ibloc = nxtsec[ibloc];
+    flstat.hops++;
   } while (ibloc != 0);
 
   if (dirsize < (disk.track0l-2) * 10)
@@ -314,89 +474,15 @@ int analyse( int strict) {
   file = malloc( sizeof( struct File) * dirsize);
   if (file == NULL) {
     perror( "file table allocation failed");
+    stat_stop( PH_ANALYSE);
     return 3;
   }
 
 // File linking analyse and feature extraction...
 
-  nfile = 0;
-  nslot = 0;
-  usedsec = 0;
   nbdirsec = 0;
-
-  ibloc = ts2blk( 0, 5); // dir starts on sector 5 (offset = 0x400)
-
-  while (nslot < dirsize) {
-    if (ibloc >= disk.track0l) // directory bloc ouside track 0
-      nbdirsec++;
-    dirsec = (struct Dirsec*)(disk.dsk + ibloc * SECSIZE);
-    for (k=0; k < 10 && nslot < dirsize; k++) {
-      file[nslot].pos = dirsec->entry[k].name;
-      if (dirsec->entry[k].name[0] == 0) {
-        file[nslot].flags = 0;
-		file[nslot].name[0] = 0;
-		nslot++;
-		continue;
-	  }
-      file[nslot].flags = 1;
-      if (dirsec->entry[k].f_day < 1 || dirsec->entry[k].f_day > 31)
-        file[nslot].day = 0;
-      else
-        file[nslot].day = (int)dirsec->entry[k].f_day;
-      if (dirsec->entry[k].f_month < 1 || dirsec->entry[k].f_month > 12)
-        file[nslot].month = 0;
-      else
-        file[nslot].month = (int)dirsec->entry[k].f_month;
-      if (dirsec->entry[k].f_year > 75)
-        file[nslot].year = (int)dirsec->entry[k].f_year + 1900;
-      else
-        file[nslot].year = (int)dirsec->entry[k].f_year + 2000;
-
-      if (dirsec->entry[k].flags) {  // random file
-        file[nslot].flags |= 2;
-      }
-      file[nslot].length = dirsec->entry[k].length[0]*256+dirsec->entry[k].length[1];
-
-//Name valid ?
-      if (getname( dirsec->entry[k].name, name, 1) < 0) {
-        printf( "%sERROR: Directory entry %d : name not valid%s\n",
-          s_err, nslot, s_norm);
-        file[nslot].flags |= 0x40;
-      }
-	  if (*name == 0)
-	    strcpy( name, "???");
-      strcpy( file[nslot].name, name);
-      file[nslot].start_trk = dirsec->entry[k].first_trk;
-      file[nslot].start_sec = dirsec->entry[k].first_sec;
-      file[nslot].end_trk   = dirsec->entry[k].last_trk;
-      file[nslot].end_sec   = dirsec->entry[k].last_sec;
-
-// first sector valid ?
-      j = ts2blk( dirsec->entry[k].first_trk, dirsec->entry[k].first_sec);
-      if ((j < 1 || j == 2) && *name != 0xFF && dirsec->entry[k].length[2] != 0) { 
-        printf( "%sERROR: Directory entry %d (%s) : sector [%02X,%02X] not valid%s\n",
-          s_err, nslot, name, dirsec->entry[k].first_trk, dirsec->entry[k].first_sec, s_norm);
-        file[nslot].length = 0;
-        file[nslot].flags |= 0x80;
-        retval = 2;
-        continue;
-      }
-// Deleted file ?
-      if (dirsec->entry[k].name[0] == 0xFF) {
-        name[0] = '?';
-        ndel++;
-        file[nslot].flags |= 0x10;
-      } else {
-	    nfile++;
-        usedsec += file[nslot].length;
-      }
-      nslot++;
-    }
-
-    // End of directory blocs ?
-    if ((ibloc = nxtsec[ibloc]) == 0)
-      break;;
-  }
+  if (scan_dir( dirsize, &nbdirsec))
+    retval = 2;
 
 // File's blocs linking analyse...
 // First pass ignore deleted files
@@ -425,6 +511,7 @@ int analyse( int strict) {
           retval = 1;
 		}
 	    tabsec[ibloc] = k+1;
+        check_seq( k, nb_blk, ibloc, disk.dsk + ibloc*SECSIZE);
         nb_blk++;
       } else if (tabsec[ibloc] == 0) {
         printf( "%sERROR: File %s (%d), sector [0x%02X/0x%02X] also in directory%s\n",
@@ -434,11 +521,14 @@ int analyse( int strict) {
 		break;
       } else { 
         printf( "%sERROR: File %s (%d), sector [0x%02X/0x%02X] also in file %s (%d)%s\n",
-          s_err, file[k].name, k+1, blk2trk(ibloc), blk2sec( ibloc), file[tabsec[ibloc]].name, tabsec[ibloc], s_norm);
+          s_err, file[k].name, k+1, blk2trk(ibloc), blk2sec( ibloc), file[tabsec[ibloc]-1].name, tabsec[ibloc], s_norm);
         file[k].flags |= 0x80;
+        retval = 1;     // only this file is lost, the others can be read
+        break;          // crosslinked or looping: the rest was already walked
       }
 	  obloc = ibloc;
       ibloc = nxtsec[ibloc];
+      flstat.hops++;
 	}
     if (nb_blk != file[k].length) {
       printf( "%sERROR: length of %s %d, but %d sectors chained%s\n",
@@ -455,8 +545,10 @@ int analyse( int strict) {
   }	  
 
   // Scan for Deleted file
+  // Their chains can't overlap: each free bloc is walked only once
 
-  for( k=0; k < nslot; k++) {
+  seen = calloc( disk.nb_sectors, 1);
+  for( k=0; k < nslot && seen != NULL; k++) {
     if (file[k].flags & 0x10) {
       file[k].flags |= 0x20;        // We hope it can be restored
 	  ibloc = ts2blk( file[k].start_trk, file[k].start_sec);
@@ -465,19 +557,23 @@ int analyse( int strict) {
           file[k].flags &= 0xdf;
           break;
         }
-        if (tabsec[ibloc] >= 0) {    // nope
+        if (tabsec[ibloc] >= 0 || seen[ibloc]) {    // nope
           file[k].flags &= 0xdf;
           break;
         }
+        seen[ibloc] = 1;
 		obloc = ibloc;
         ibloc = nxtsec[ibloc];
+        flstat.hops++;
       }
       if (j != file[k].length && obloc != ts2blk( file[k].end_trk, file[k].end_sec))
           file[k].flags &= 0xdf;    //nope
     }
   }
+  free( seen);
 
-  if (nbdirsec) {
+// Allowed: flwrite grows the directory there when track 0 is full
+  if (nbdirsec && !quiet) {
     printf( "%sWarning: %d sectors used by directory outside track 0%s\n",
       s_warn, nbdirsec, s_norm);
   }
@@ -518,9 +614,175 @@ int analyse( int strict) {
     }
   }
 
+  stat_stop( PH_ANALYSE);
+  return retval;
+}
+
+//////////////////////////////////////////////////////
+// Lazy analyse: only the SIR and directory chain   //
+// are read, file chains are verified on demand by  //
+// check_file(). tabsec and nxtsec are not built.   //
+//////////////////////////////////////////////////////
+
+int analyse_dir( int strict) {
+
+  int dirsize;            // directory max size in files
+  int nbdirsec;           // number of directory's sectors not on track 0
+  int ibloc;              // current directory bloc
+  int retval = 0;         // return value (0 if OK)
+
+  stat_start( PH_ANALYSE);
+// Track 0 is read at once if the image is partially loaded
+  if (disk.loaded != NULL && read_sectors( 0, disk.track0l)) {
+    stat_stop( PH_ANALYSE);
+    return 3;
+  }
+
+// Count the directory blocs, a loop can't be longer than the disk
+  dirsize = 0;
+  ibloc = ts2blk( 0, 5);
+  do {
+    dirsize += 10;
+    if (dirsize > disk.nb_sectors * 10) {
+      printf( "%sERROR: Directory sector %d [0x%02X/0x%02X] used twice (loop)%s\n",
+        s_err, ibloc, blk2trk( ibloc), blk2sec( ibloc), s_norm);
+      stat_stop( PH_ANALYSE);
+      return 3;
+    }
+    if ((ibloc = nextblk( ibloc)) < 0) {
+      if (strict)
+        printf( "%sERROR: Directory chain link out of bounds%s\n", s_err, s_norm);
+      retval = 1;
+    }
+  } while (ibloc > 0);
+
+  if (dirsize < (disk.track0l-2) * 10)
+    dirsize = (disk.track0l-2) * 10;
+
+  file = malloc( sizeof( struct File) * dirsize);
+  if (file == NULL) {
+    perror( "file table allocation failed");
+    stat_stop( PH_ANALYSE);
+    return 3;
+  }
+
+  nbdirsec = 0;
+  if (scan_dir( dirsize, &nbdirsec))
+    retval = 2;
+
+  if (nbdirsec && strict) {
+    printf( "%sWarning: %d sectors used by directory outside track 0%s\n",
+      s_warn, nbdirsec, s_norm);
+  }
+
+  stat_stop( PH_ANALYSE);
   return retval;
 }
 
+/////////////////////////////////////////////////////
+// Verify the sector chain of one file (lazy mode) //
+// Return the file flags, with 0x40 (unusable),    //
+// 0x80 (corrupted) or 0x08 (bad record numbers)   //
+// set if problems are detected                    //
+/////////////////////////////////////////////////////
+
+int check_file( int k) {
+
+  int ibloc, obloc;       // bloc index for navigation
+  int nb_blk;             // nb of blocs chained
+
+  if (nxtsec != NULL)     // Already done by analyse()
+    return file[k].flags;
+
+  stat_start( PH_ANALYSE);
+  ibloc = ts2blk( file[k].start_trk, file[k].start_sec);
+  if (ibloc < 1) {
+    printf( "%sERROR: File %s (%d), first sector [0x%02X/0x%02X] out of bounds%s\n",
+      s_err, file[k].name, k+1, file[k].start_trk, file[k].start_sec, s_norm);
+    file[k].flags |= 0x80;
+    stat_stop( PH_ANALYSE);
+    return file[k].flags;
+  }
+
+// tabsec keeps the file owning each bloc walked: a loop or a
+// crosslink stops the walk, and no bloc is walked twice
+  if (tabsec == NULL && (tabsec = calloc( disk.nb_sectors, sizeof( int))) == NULL) {
+    perror( "sector table allocation failed");
+    file[k].flags |= 0x80;
+    stat_stop( PH_ANALYSE);
+    return file[k].flags;
+  }
+  if (tabsec[ibloc] == k+1) {  // already checked
+    stat_stop( PH_ANALYSE);
+    return file[k].flags;
+  }
+
+// Never walk more than the length of the file + 1
+  nb_blk = 0;
+  obloc = ibloc;
+  while (ibloc > 0 && nb_blk <= file[k].length) {
+    if (tabsec[ibloc] == k+1) {
+      printf( "%sERROR: File %s (%d), chain loops%s\n", s_err, file[k].name, k+1, s_norm);
+      file[k].flags |= 0x80;
+      break;
+    } else if (tabsec[ibloc] != 0) {
+      printf( "%sERROR: File %s (%d), sector [0x%02X/0x%02X] also in file %s (%d)%s\n",
+        s_err, file[k].name, k+1, blk2trk( ibloc), blk2sec( ibloc),
+        file[tabsec[ibloc]-1].name, tabsec[ibloc], s_norm);
+      file[k].flags |= 0x80;
+      break;
+    }
+    tabsec[ibloc] = k+1;
+    check_seq( k, nb_blk, ibloc, getsec( ibloc));
+    nb_blk++;
+    obloc = ibloc;
+    ibloc = nextblk( ibloc);
+  }
+  if (ibloc < 0) {
+    printf( "%sERROR: File %s (%d), sector [0x%02X/0x%02X] link out of bounds%s\n",
+      s_err, file[k].name, k+1, blk2trk( obloc), blk2sec( obloc), s_norm);
+    file[k].flags |= 0x80;
+  }
+  if (nb_blk != file[k].length) {
+    if (nb_blk > file[k].length)
+      printf( "%sERROR: length of %s %d, but more sectors chained%s\n",
+        s_err, file[k].name, file[k].length, s_norm);
+    else
+      printf( "%sERROR: length of %s %d, but %d sectors chained%s\n",
+        s_err, file[k].name, file[k].length, nb_blk, s_norm);
+    file[k].flags |= 0x40;
+  }
+  if ((blk2trk( obloc) != file[k].end_trk || blk2sec( obloc) != file[k].end_sec) &&
+     file[k].length != 0) {
+    printf( "%sERROR: last track/sector don't match [0x%02X/0x%02X] vs [0x%02X/0x%02X]%s\n",
+      s_err, blk2trk( obloc), blk2sec( obloc), file[k].end_trk, file[k].end_sec, s_norm);
+    file[k].flags |= 0x80;
+  }
+
+  stat_stop( PH_ANALYSE);
+  return file[k].flags;
+}
+
+//////////////////////////////////////////////////////
+// Find a valid file by its name (case insensitive) //
+// Return its index in file[], or -1 if not found   //
+//////////////////////////////////////////////////////
+
+int find_file( char *name) {
+  char fname[16];
+  int k;
+
+  if (strlen( name) > 12)  // incompatible length
+    return -1;
+  for (k = 0; name[k]; k++)
+    fname[k] = toupper( name[k]);
+  fname[k] = 0;
+  for (k = 0; k < nslot; k++)
+    if ((file[k].flags & 0x11) == 1 && strcmp( (char *)file[k].name, fname) == 0)
+      return k;
+  return -1;
+}
+
 ///////////////////////////////////////////////////////////
 // Convert track/sector to bloc number on the disc image //
 // Return -1 if track or sector number out of bound      //
@@ -573,7 +835,7 @@ uint8_t *ts2pos( uint8_t ntrk, uint8_t nsec) {
   int pos;
     if ((pos = ts2blk( ntrk, nsec)) < 0)
         return NULL;
-    return disk.dsk + pos * SECSIZE;
+    return getsec( pos);
 }
 
 ///////////////////////////////////////////////////////
@@ -634,6 +896,8 @@ int list_files( int details) {
           printf( " %sCORRUPTED%s", s_err, s_norm);
         if (file[k].flags & 0x40)
           printf( " %sUNUSABLE%s", s_warn, s_norm);
+        if (file[k].flags & 0x08)
+          printf( " %sBAD SEQUENCE%s", s_warn, s_norm);
         if (file[k].flags & 0x20)
           printf( " (maybe recoverable)");
         putchar( '\n');